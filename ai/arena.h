@@ -0,0 +1,89 @@
+#ifndef BLOKUS_AI_ARENA_H
+#define BLOKUS_AI_ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace blokus {
+
+// Hands out contiguous blocks of objects, carved out of large chunks of
+// memory. Objects are never freed one by one. Instead, Reset() releases all of
+// them at once, and keeps the chunks around to be reused.
+//
+// An arena must only be used by one thread at a time.
+class Arena {
+ public:
+  // The number of bytes in a chunk. Bigger blocks get a chunk of their own.
+  static constexpr size_t kChunkSize = 1 << 20;
+
+  Arena() = default;
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+  Arena(Arena&&) = default;
+  Arena& operator=(Arena&&) = default;
+
+  // Returns `n` contiguous, value initialized objects of type T.
+  template <typename T>
+  T* Allocate(size_t n);
+
+  // Releases all objects allocated so far.
+  void Reset() {
+    chunk_ = 0;
+    used_ = 0;
+    size_ = 0;
+  }
+
+  // Returns the number of bytes allocated since the last Reset().
+  size_t size() const { return size_; }
+
+ private:
+  struct Chunk {
+    std::unique_ptr<std::byte[]> memory;
+    size_t capacity;
+  };
+
+  std::vector<Chunk> chunks_;
+  // The chunk that is being allocated from, and how much of it is used.
+  size_t chunk_ = 0;
+  size_t used_ = 0;
+  size_t size_ = 0;
+};
+
+template <typename T>
+T* Arena::Allocate(size_t n) {
+  static_assert(std::is_trivially_destructible_v<T>,
+                "Arena never runs destructors");
+  static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__,
+                "Chunks only have the default alignment");
+
+  // Find the next chunk with enough room, reusing chunks from before the last
+  // Reset() if possible.
+  const size_t bytes = n * sizeof(T);
+  size_t offset = (used_ + alignof(T) - 1) / alignof(T) * alignof(T);
+  while (chunk_ < chunks_.size() &&
+         offset + bytes > chunks_[chunk_].capacity) {
+    ++chunk_;
+    offset = 0;
+  }
+  if (chunk_ == chunks_.size()) {
+    const size_t capacity = std::max(bytes, kChunkSize);
+    chunks_.push_back({std::make_unique<std::byte[]>(capacity), capacity});
+    offset = 0;
+  }
+
+  T* block = reinterpret_cast<T*>(chunks_[chunk_].memory.get() + offset);
+  for (size_t i = 0; i < n; ++i) {
+    new (block + i) T();
+  }
+  used_ = offset + bytes;
+  size_ += bytes;
+  return block;
+}
+
+}  // namespace blokus
+
+#endif
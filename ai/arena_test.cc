@@ -0,0 +1,63 @@
+#include "ai/arena.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace blokus {
+namespace {
+
+using ::testing::Each;
+using ::testing::Eq;
+
+TEST(ArenaTest, AllocatesValueInitializedObjects) {
+  Arena arena;
+  int* ints = arena.Allocate<int>(10);
+  EXPECT_THAT(std::vector<int>(ints, ints + 10), Each(0));
+}
+
+TEST(ArenaTest, SizeCountsAllocatedBytes) {
+  Arena arena;
+  EXPECT_THAT(arena.size(), Eq(0));
+  arena.Allocate<int>(10);
+  EXPECT_THAT(arena.size(), Eq(10 * sizeof(int)));
+  arena.Allocate<char>(3);
+  EXPECT_THAT(arena.size(), Eq(10 * sizeof(int) + 3));
+  // Blocks bigger than a chunk count in full too.
+  arena.Allocate<char>(2 * Arena::kChunkSize);
+  EXPECT_THAT(arena.size(), Eq(10 * sizeof(int) + 3 + 2 * Arena::kChunkSize));
+}
+
+TEST(ArenaTest, BlocksDontOverlap) {
+  Arena arena;
+  char* a = arena.Allocate<char>(3);
+  double* b = arena.Allocate<double>(2);
+  EXPECT_THAT(reinterpret_cast<uintptr_t>(b) % alignof(double), Eq(0));
+  EXPECT_GE(reinterpret_cast<char*>(b), a + 3);
+
+  // A block that doesn't fit in the rest of the first chunk starts a new one.
+  char* c = arena.Allocate<char>(Arena::kChunkSize - 1);
+  EXPECT_TRUE(c < a || c >= a + Arena::kChunkSize);
+}
+
+TEST(ArenaTest, ResetReusesChunks) {
+  Arena arena;
+  int* first = arena.Allocate<int>(100);
+  for (int i = 0; i < 100; ++i) first[i] = i + 1;
+  char* big = arena.Allocate<char>(Arena::kChunkSize);
+
+  arena.Reset();
+  EXPECT_THAT(arena.size(), Eq(0));
+
+  // The same memory is handed out again, value initialized once more.
+  int* second = arena.Allocate<int>(100);
+  EXPECT_THAT(second, Eq(first));
+  EXPECT_THAT(std::vector<int>(second, second + 100), Each(0));
+  EXPECT_THAT(arena.Allocate<char>(Arena::kChunkSize), Eq(big));
+  EXPECT_THAT(arena.size(), Eq(100 * sizeof(int) + Arena::kChunkSize));
+}
+
+}  // namespace
+}  // namespace blokus
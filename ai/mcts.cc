@@ -1,262 +1,763 @@
 #include "ai/mcts.h"
 
+#include <algorithm>
 #include <atomic>
 #include <cmath>
 #include <limits>
+#include <queue>
 #include <thread>
 
 #include "absl/log/check.h"
 #include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 
 namespace blokus {
 
 // A node in the game tree.
 // Technically, this also includes edges going out from this node.
+//
+// Nodes are shared by all worker threads without a lock. Statistics are
+// atomics, and children are published once, by the thread that expands the
+// node. Nodes live in the arenas of MctsAI.
+//
+// The statistics of the edges to the children are kept in the parent, with
+// one contiguous array per statistic, so that selection can scan them without
+// touching the children themselves. Most moves are never selected more than
+// once, so a child node is only allocated when its move is selected for the
+// second time.
 struct Node {
   std::string DebugString() const;
 
-  // The move that caused us to arrive at this node, i.e. the incoming edge
-  // to this node.
-  Move move;
+  Node* parent = nullptr;
 
-  // The player that played the above move.
-  int player = -1;
+  // The index of this node in the children of its parent.
+  int index = 0;
 
-  // The number of wins tracked for having made the above move.
-  int wins = 0;
+  // The number of times rollouts have visited this node. This is only kept
+  // for the root, every other node is counted by its parent. See Visits().
+  std::atomic<int> visits = 0;
 
-  // The number of times rollouts have visited the above move.
-  int visits = 0;
+  // Set by the thread that expands the node, so that no other thread does.
+  std::atomic<bool> expanding = false;
 
-  Node* parent = nullptr;
-  std::vector<std::unique_ptr<Node>> children;
+  // Set once the node is expanded. The child arrays below are only valid
+  // after that.
+  std::atomic<bool> expanded = false;
+
+  // The number of children.
+  int num_children = 0;
+
+  // The player and color that play the moves to the children.
+  int child_player = -1;
+  Color child_color = INVALID;
+
+  // The moves to the children.
+  MoveId* child_moves = nullptr;
+
+  // The number of wins tracked for having made each move.
+  std::atomic<int>* child_wins = nullptr;
+
+  // The number of times rollouts have visited each move.
+  std::atomic<int>* child_visits = nullptr;
+
+  // The number of threads whose current iteration passes through each move.
+  // Selection counts these as visits that were lost, which steers other
+  // threads towards different parts of the tree until the rollouts finish.
+  std::atomic<int>* child_virtual_losses = nullptr;
+
+  // With MctsOptions::use_transpositions, the statistics of the position
+  // reached by each move, shared with all other nodes that reach it. Set the
+  // first time the move is selected. Null without transpositions.
+  std::atomic<PositionStats*>* child_positions = nullptr;
+
+  // The node reached by each move, or null if it hasn't been needed yet.
+  std::atomic<Node*>* children = nullptr;
 };
 
 namespace {
 
+// The number of iterations a worker thread claims at a time.
+constexpr int kIterationBatch = 16;
+
+// Returns the number of times rollouts have visited `node`.
+int Visits(const Node& node) {
+  if (node.parent == nullptr) {
+    return node.visits.load(std::memory_order_relaxed);
+  }
+  return node.parent->child_visits[node.index].load(std::memory_order_relaxed);
+}
+
 bool ShouldExpand(const Game& game, const Node& node) {
   if (game.Finished()) return false;
   CHECK(node.parent != nullptr);
-  CHECK(!node.parent->children.empty());
-  return node.parent->visits >= node.parent->children.size();
+  CHECK(node.parent->expanded.load(std::memory_order_acquire));
+  return Visits(*node.parent) >= node.parent->num_children;
+}
+
+// Allocates the child arrays of `node` from `arena`, including
+// child_positions if `with_positions`. The children themselves are allocated
+// later, by GetOrCreateChild.
+void AllocateChildArrays(Node* node, int num_children, bool with_positions,
+                         Arena* arena) {
+  node->num_children = num_children;
+  node->child_moves = arena->Allocate<MoveId>(num_children);
+  node->child_wins = arena->Allocate<std::atomic<int>>(num_children);
+  node->child_visits = arena->Allocate<std::atomic<int>>(num_children);
+  node->child_virtual_losses =
+      arena->Allocate<std::atomic<int>>(num_children);
+  if (with_positions) {
+    node->child_positions =
+        arena->Allocate<std::atomic<PositionStats*>>(num_children);
+  }
+  node->children = arena->Allocate<std::atomic<Node*>>(num_children);
+}
+
+// Returns the child `index` of the expanded `node`, allocating it from `arena`
+// if it doesn't exist yet.
+Node* GetOrCreateChild(Node* node, int index, Arena* arena) {
+  Node* child = node->children[index].load(std::memory_order_acquire);
+  if (child != nullptr) return child;
+
+  Node* new_child = arena->Allocate<Node>(1);
+  new_child->parent = node;
+  new_child->index = index;
+  // If another thread got there first, use its child. Ours stays unused in
+  // the arena until the tree is released.
+  if (node->children[index].compare_exchange_strong(
+          child, new_child, std::memory_order_acq_rel)) {
+    return new_child;
+  }
+  return child;
+}
+
+// Expands `node`, allocating its child arrays from `arena`. Returns false if
+// another thread is already expanding the node.
+bool ExpandNode(const Game& game, Node* node, bool with_positions,
+                Arena* arena) {
+  if (node->expanding.exchange(true, std::memory_order_relaxed)) {
+    return false;
+  }
+
+  // Look for possible moves, and create a child for each move.
+  MoveList possible_moves;
+  game.GenerateMoves(&possible_moves);
+
+  // Colors without moves pass before their turn, and finished games aren't
+  // expanded, so there is always a move.
+  CHECK(!possible_moves.empty());
+
+  AllocateChildArrays(node, possible_moves.size(), with_positions, arena);
+  node->child_player = game.current_player();
+  node->child_color = game.current_color();
+  std::copy(possible_moves.begin(), possible_moves.end(), node->child_moves);
+  node->expanded.store(true, std::memory_order_release);
+  return true;
+}
+
+// Copies `from` and its descendants to `to`, allocating the copies of the
+// descendants from `arena`. Descendants are copied most visited first, until
+// the copies take `max_bytes`. The rest are left out, so their moves keep
+// their statistics but lose their subtrees. Must not run concurrently with
+// iterations.
+void CopySubtree(const Node& from, Node* to, Arena* arena, size_t max_bytes) {
+  // A descendant that is waiting to be copied, once its parent has been.
+  struct Pending {
+    int visits;
+    const Node* from;
+    Node* to_parent;
+  };
+  const auto fewer_visits = [](const Pending& a, const Pending& b) {
+    return a.visits < b.visits;
+  };
+  std::priority_queue<Pending, std::vector<Pending>, decltype(fewer_visits)>
+      pending(fewer_visits);
+
+  const auto copy_node = [&pending, arena](const Node& from, Node* to) {
+    to->visits.store(Visits(from));
+
+    if (!from.expanded.load()) return;
+    AllocateChildArrays(to, from.num_children,
+                        from.child_positions != nullptr, arena);
+    to->child_player = from.child_player;
+    to->child_color = from.child_color;
+    for (int i = 0; i < from.num_children; ++i) {
+      to->child_moves[i] = from.child_moves[i];
+      to->child_wins[i].store(from.child_wins[i].load());
+      to->child_visits[i].store(from.child_visits[i].load());
+      if (from.child_positions != nullptr) {
+        to->child_positions[i].store(from.child_positions[i].load());
+      }
+      const Node* child = from.children[i].load();
+      if (child != nullptr) {
+        pending.push({to->child_visits[i].load(), child, to});
+      }
+    }
+    to->expanding.store(true);
+    to->expanded.store(true);
+  };
+
+  const size_t start_bytes = arena->size();
+  copy_node(from, to);
+  while (!pending.empty() && arena->size() - start_bytes < max_bytes) {
+    const Pending next = pending.top();
+    pending.pop();
+    copy_node(*next.from,
+              GetOrCreateChild(next.to_parent, next.from->index, arena));
+  }
 }
 
-void ExpandNode(const Game& game, Node* node) {
-  CHECK(node->children.empty()) << "Expanding a non-leaf node: "
-                                << node->DebugString();
-
-  // Look for possible moves, and if found, create a child for each move.
-  std::vector<Move> possible_moves = game.PossibleMoves();
-  node->children.reserve(possible_moves.size());
-  for (const Move& move : possible_moves) {
-    auto child_node = std::make_unique<Node>();
-    child_node->move = move;
-    child_node->player = game.current_player();
-    child_node->parent = node;
-    node->children.push_back(std::move(child_node));
-  }
-
-  // If there are no possible moves, create an empty move for this node.
-  if (node->children.empty()) {
-    auto child_node = std::make_unique<Node>();
-    child_node->move = Move::EmptyMove(game.current_color());
-    child_node->player = game.current_player();
-    child_node->parent = node;
-    node->children.push_back(std::move(child_node));
+// Returns the index of the child of the expanded `node` with the highest
+// UCB1 value. If there are multiple children with the max UCB1, then one of
+// them is selected randomly. This prevents biasing towards certain moves at
+// the start of expansion.
+//
+// This only reads the child arrays of `node`, and doesn't allocate.
+int SelectChild(const Node& node, double c, Rng* rng) {
+  // The visits of the node itself, including the threads in flight.
+  int node_visits = Visits(node);
+  if (node.parent != nullptr) {
+    node_visits += node.parent->child_virtual_losses[node.index].load(
+        std::memory_order_relaxed);
+  }
+  // Threads in flight at the root are not counted, so avoid log(0).
+  const double logN = std::log(std::max(node_visits, 1));
+
+  const auto ucb1 = [&](int i) {
+    const int visits =
+        node.child_visits[i].load(std::memory_order_relaxed) +
+        node.child_virtual_losses[i].load(std::memory_order_relaxed);
+    if (visits == 0) return std::numeric_limits<double>::infinity();
+    // Prefer the position's statistics, since they include rollouts that
+    // reached it through other move orders.
+    const PositionStats* position =
+        node.child_positions != nullptr
+            ? node.child_positions[i].load(std::memory_order_acquire)
+            : nullptr;
+    const int position_visits =
+        position != nullptr ? position->visits.load(std::memory_order_relaxed)
+                            : 0;
+    const double win_rate =
+        position_visits > 0
+            ? 1.0 * position->wins.load(std::memory_order_relaxed) /
+                  position_visits
+            : 1.0 * node.child_wins[i].load(std::memory_order_relaxed) /
+                  visits;
+    return win_rate + c * std::sqrt(logN / visits);
+  };
+
+  // Find the max UCB1, and how many children have it.
+  double max_ucb1 = -std::numeric_limits<double>::infinity();
+  int best = 0;
+  int num_best = 0;
+  for (int i = 0; i < node.num_children; ++i) {
+    const double value = ucb1(i);
+    if (value > max_ucb1) {
+      max_ucb1 = value;
+      best = i;
+      num_best = 1;
+    } else if (value == max_ucb1) {
+      ++num_best;
+    }
   }
+  if (num_best <= 1) return best;
+
+  // Pick one of them at random. Other threads may have changed the statistics
+  // in the meantime, in which case we settle for the first one.
+  int skip = rng->Uniform(num_best);
+  for (int i = best; i < node.num_children; ++i) {
+    if (ucb1(i) == max_ucb1 && skip-- == 0) return i;
+  }
+  return best;
 }
 
 // Returns a pointer to a leaf-node in the game tree starting from `node`.
 // The `game` is modified to reflect the state as moves are made following
-// the nodes recursiverly down.
+// the nodes recursiverly down, and an undo for each move is appended to
+// `undo_stack`.
 //
-// A leaf node is defined as a node that has no children.
+// A leaf node is defined as a node that has no children. A move that is
+// selected for the first time doesn't have a node yet, in which case its
+// parent is returned and `leaf_move` is set to the index of the move.
+// Otherwise `leaf_move` is set to -1.
 //
 // Note that this function also includes the "expansion" phase in usual
 // MCTS terminology. A leaf node is only expanded if all siblings have been
 // visited at least once. After expansion, we return a child.
-Node* SelectNode(Node* node, Game* game, double c) {
+//
+// A virtual loss is added to every selected move, which the caller has to
+// remove once it has backpropagated the rollout results.
+//
+// If `transpositions` is not null, moves are linked to the shared statistics
+// of their position the first time they are selected, and
+// `num_transpositions` counts how many of those positions were already known.
+//
+// If `can_grow` is false, no nodes are expanded or created, no moves are
+// linked to positions, and selection stops where the tree ends.
+Node* SelectNode(Node* node, Game* game, std::vector<Game::Undo>* undo_stack,
+                 Arena* arena, Rng* rng, double c, bool can_grow,
+                 TranspositionTable* transpositions,
+                 std::atomic<int64_t>* num_transpositions, int* leaf_move) {
+  *leaf_move = -1;
   // If a leaf node, possibly expand it and continue selection.
-  if (node->children.empty()) {
-    if (!ShouldExpand(*game, *node)) {
+  if (!node->expanded.load(std::memory_order_acquire)) {
+    if (!can_grow || !ShouldExpand(*game, *node)) {
+      return node;
+    }
+    // Another thread is expanding the node, so treat it as a leaf for now.
+    if (!ExpandNode(*game, node, transpositions != nullptr, arena)) {
       return node;
     }
-    ExpandNode(*game, node);
   }
 
   // Pick the best child by UCB1 and recurse.
-  std::vector<double> ucb1(
-      node->children.size(), std::numeric_limits<double>::infinity());
-  const double logN = std::log(node->visits);
-  for (size_t i = 0; i < node->children.size(); ++i) {
-    const Node& child = *node->children[i];
-    if (child.visits == 0) continue;
-    ucb1[i] =
-        1.0 * child.wins / child.visits + c * std::sqrt(logN / child.visits);
-  }
-
-  // If there are multiple children with the max UCB1, then select randomly.
-  // This prevents biasing towards certain moves at the start of expansion.
-  double max_ucb1 = *std::max_element(ucb1.begin(), ucb1.end());
-  std::vector<int> children_with_max;
-  for (size_t i = 0; i < node->children.size(); ++i) {
-    if (ucb1[i] == max_ucb1) {
-      children_with_max.push_back(i);
+  const int index = SelectChild(*node, c, rng);
+  const int selections =
+      node->child_visits[index].load(std::memory_order_relaxed) +
+      node->child_virtual_losses[index].fetch_add(1,
+                                                  std::memory_order_relaxed);
+
+  undo_stack->emplace_back();
+  const Move move = ToMove(node->child_moves[index], node->child_color);
+  CHECK(game->MakeMove(move, &undo_stack->back()))
+      << "SelectNode tried " << move.DebugString();
+
+  // The table counts toward the tree's size, so a full tree doesn't add to it
+  // either.
+  if (transpositions != nullptr && can_grow &&
+      node->child_positions[index].load(std::memory_order_relaxed) ==
+          nullptr) {
+    bool found = false;
+    PositionStats* position =
+        transpositions->Lookup(game->hash(), game->num_moves(), &found);
+    // Only count the transposition once, if several threads link the move at
+    // the same time.
+    PositionStats* expected = nullptr;
+    if (node->child_positions[index].compare_exchange_strong(
+            expected, position, std::memory_order_acq_rel) &&
+        found) {
+      num_transpositions->fetch_add(1, std::memory_order_relaxed);
     }
   }
-  int selected_child = children_with_max[rand() % children_with_max.size()];
-  
-  CHECK(game->MakeMove(node->children[selected_child]->move))
-      << "SelectNode tried "
-      << node->children[selected_child]->move.DebugString();
+
+  // The first selection of a move only needs its statistics, and so does
+  // every selection once the tree is full.
+  if ((selections == 0 || !can_grow) &&
+      node->children[index].load(std::memory_order_acquire) == nullptr) {
+    *leaf_move = index;
+    return node;
+  }
   
-  return SelectNode(node->children[selected_child].get(), game, c);
+  return SelectNode(GetOrCreateChild(node, index, arena), game, undo_stack,
+                    arena, rng, c, can_grow, transpositions,
+                    num_transpositions, leaf_move);
+}
+
+// Returns true if no child of the expanded `root` can overtake the most
+// visited one with `remaining_visits` more visits.
+bool MoveIsDecided(const Node& root, double remaining_visits) {
+  int most_visits = 0;
+  int second_visits = 0;
+  for (int i = 0; i < root.num_children; ++i) {
+    const int visits = root.child_visits[i].load(std::memory_order_relaxed);
+    if (visits > most_visits) {
+      second_visits = most_visits;
+      most_visits = visits;
+    } else if (visits > second_visits) {
+      second_visits = visits;
+    }
+  }
+  return most_visits - second_visits > remaining_visits;
 }
 
+// Records a rollout won by `winner` that went through move `index` of the
+// expanded `node`.
+void UpdateMove(Node* node, int index, int winner) {
+  const bool won = node->child_player == winner;
+  node->child_visits[index].fetch_add(1, std::memory_order_relaxed);
+  if (won) {
+    node->child_wins[index].fetch_add(1, std::memory_order_relaxed);
+  }
+  PositionStats* position =
+      node->child_positions != nullptr
+          ? node->child_positions[index].load(std::memory_order_acquire)
+          : nullptr;
+  if (position != nullptr) {
+    position->visits.fetch_add(1, std::memory_order_relaxed);
+    if (won) {
+      position->wins.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+}
 
 }  // namespace
 
 std::string Node::DebugString() const {
-  if (move.color == INVALID) {
-    return "uninitialized";
+  const int num_expanded =
+      expanded.load(std::memory_order_acquire) ? num_children : 0;
+  if (parent == nullptr) {
+    return absl::StrFormat("root %d visits, %d children", visits.load(),
+                           num_expanded);
   }
-  
-  const double win_rate = visits > 0 ? static_cast<float>(wins) / visits : 0.0;
-  return absl::StrFormat("(%.3f %d/%d), %d children, %s", win_rate, wins,
-                         visits, children.size(), move.DebugString());
+
+  const int wins = parent->child_wins[index].load();
+  const int edge_visits = parent->child_visits[index].load();
+  const double win_rate =
+      edge_visits > 0 ? static_cast<float>(wins) / edge_visits : 0.0;
+  return absl::StrFormat(
+      "(%.3f %d/%d), %d children, %s", win_rate, wins, edge_visits,
+      num_expanded, ToMove(parent->child_moves[index], parent->child_color).DebugString());
 }
 
-int Rollout(Game game) {
+int Rollout(Game game, Rng* rng) {
   while (!game.Finished()) {
-    std::vector<Move> possible_moves = game.PossibleMoves();
-    Move move = Move::EmptyMove(game.current_color());
-    if (!possible_moves.empty()) {
-      move = possible_moves[rand() % possible_moves.size()];
-    }
-    CHECK(game.MakeMove(move));
+    const MoveId move = game.SampleMove(rng);
+    CHECK(game.MakeMove(ToMove(move, game.current_color())));
   }
   // TODO(piotrf): use score margin as well?
   return game.Result().winner_id;
 }
 
-MctsAI::MctsAI(int player_id, const MctsOptions& options) :
-    Player(player_id), options_(options), tree_(std::make_unique<Node>()) {}
+MctsAI::MctsAI(int player_id, const MctsOptions& options)
+    : Player(player_id),
+      options_(options),
+      pool_(std::max(options_.num_threads, 1)) {
+  const int num_threads = pool_.num_threads();
+  for (std::vector<Arena>& arenas : arenas_) {
+    arenas.resize(num_threads);
+  }
+  // Every player and thread draws from its own stream of the seed.
+  for (int i = 0; i < num_threads; ++i) {
+    workers_.emplace_back(
+        Rng(options_.seed, static_cast<uint64_t>(player_id) * num_threads + i));
+  }
+  tree_ = arenas_[generation_][0].Allocate<Node>(1);
+}
 
-MctsAI::~MctsAI() {}
+MctsAI::~MctsAI() {
+  StopPondering();
+  WaitForReroot();
+}
 
-void MctsAI::Iteration(Game game) {  
-  // Select and possibly expand a node.
-  Node* node = nullptr;
-  {
-    std::lock_guard<std::mutex> lock(tree_mutex_);
-    node = SelectNode(tree_.get(), &game, options_.c);
+void MctsAI::Reroot(const Node* root) {
+  std::vector<Arena>& next_arenas = arenas_[1 - generation_];
+  Node* next_tree = next_arenas[0].Allocate<Node>(1);
+  if (root != nullptr) {
+    // Leave room for the next search to grow the tree.
+    CopySubtree(*root, next_tree, &next_arenas[0],
+                options_.max_tree_bytes > 0
+                    ? options_.max_tree_bytes / 2
+                    : std::numeric_limits<size_t>::max());
   }
+  for (Arena& arena : arenas_[generation_]) {
+    arena.Reset();
+  }
+  generation_ = 1 - generation_;
+  tree_ = next_tree;
+}
+
+void MctsAI::RerootInBackground(Node* root) {
+  reroot_thread_ = std::thread([this, root]() { Reroot(root); });
+}
+
+void MctsAI::WaitForReroot() {
+  if (reroot_thread_.joinable()) {
+    reroot_thread_.join();
+  }
+}
+
+absl::Duration MctsAI::MoveBudget(const Game& game) const {
+  absl::Duration budget = absl::InfiniteDuration();
+  if (options_.time_per_move > absl::ZeroDuration()) {
+    budget = options_.time_per_move;
+  }
+  if (options_.time_per_game > absl::ZeroDuration()) {
+    // Count the tiles that the AI may still play, with any of its colors.
+    int num_tiles = 0;
+    for (Color color : {BLUE, YELLOW, RED, GREEN}) {
+      if (game.PlayerOf(color) != player_id()) continue;
+      const uint32_t dead_tiles = game.board().dead_tiles(color);
+      for (int tile = 0; tile < kNumTiles; ++tile) {
+        if (game.HasTile(color, tile) && !(dead_tiles & (1u << tile))) {
+          ++num_tiles;
+        }
+      }
+    }
+    const absl::Duration time_left =
+        std::max(options_.time_per_game - time_used_, absl::ZeroDuration());
+    budget = std::min(budget, time_left / std::max(num_tiles, 1));
+  }
+  return budget;
+}
+
+void MctsAI::Iteration(Game* game, std::vector<Game::Undo>* undo_stack,
+                       Arena* arena, Rng* rng) {
+  // Select and possibly expand a node, if there is room.
+  const bool can_grow =
+      options_.max_tree_bytes == 0 ||
+      tree_bytes_.load(std::memory_order_relaxed) + transpositions_.bytes() <
+          options_.max_tree_bytes;
+  int leaf_move = -1;
+  Node* node = SelectNode(
+      tree_, game, undo_stack, arena, rng, options_.c, can_grow,
+      options_.use_transpositions ? &transpositions_ : nullptr,
+      &num_transpositions_, &leaf_move);
+  CHECK(node->parent != nullptr || leaf_move >= 0);
 
   // Run rollouts on the selected node.
   for (int i = 0; i < options_.num_rollouts_per_iteration; ++i) {
     // TODO(piotrf): re-enable vlog once absl supports it
     //  VLOG(3) << "  MCTS running rollout " << i;
-    int winner = Rollout(game);
+    int winner = Rollout(*game, rng);
     // TODO(piotrf): re-enable vlog once absl supports it
     //  VLOG(3) << "   rollout winner is " << winner;
 
     // Bookkeeping on the winner.
-    std::lock_guard<std::mutex> lock(tree_mutex_);
+    if (leaf_move >= 0) {
+      UpdateMove(node, leaf_move, winner);
+    }
     Node* update_node = node;
-    CHECK(update_node->parent != nullptr);
-    while (update_node != nullptr) {
-      update_node->visits++;
-      if (update_node->player == winner) {
-        update_node->wins++;
-      }
-      update_node = update_node->parent;
+    for (; update_node->parent != nullptr;
+         update_node = update_node->parent) {
+      UpdateMove(update_node->parent, update_node->index, winner);
     }
+    update_node->visits.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // The rollouts are done, so remove the virtual losses from selection.
+  if (leaf_move >= 0) {
+    node->child_virtual_losses[leaf_move].fetch_sub(
+        1, std::memory_order_relaxed);
+  }
+  for (Node* update_node = node; update_node->parent != nullptr;
+       update_node = update_node->parent) {
+    update_node->parent->child_virtual_losses[update_node->index].fetch_sub(
+        1, std::memory_order_relaxed);
   }
 }
 
-Move MctsAI::SelectMove(const Game& game) {
-  // Unless this is our first move, update tree based on last moves.
-  for (size_t i = game.moves().size() - game.num_players() + 1;
-       i < game.moves().size(); ++i) {
-    if (i < 0) continue;
+void MctsAI::FollowMoves(const Game& game) {
+  WaitForReroot();
+
+  // Find the moves made since the root of the tree. Colors that passed don't
+  // get a turn, so after our own move there can be anywhere from none to one
+  // for every other color.
+  const Node* root = tree_;
+  const int num_new_moves = game.num_moves() - tree_num_moves_;
+  if (num_new_moves < 0 ||
+      num_new_moves > std::min(game.num_moves(), Game::kNumRecentMoves)) {
+    // The tree is for some other game.
+    root = nullptr;
+  }
+  for (int i = num_new_moves - 1; root != nullptr && i >= 0; --i) {
     // TODO(piotrf): re-enable vlog once absl supports it
-    //  VLOG(1) << "MCTS updating tree for move " << game.moves()[i].DebugString();
-    //  VLOG(1) << " current tree_: " << tree_->DebugString();
-    if (tree_->children.empty()) {
+    //  VLOG(1) << "MCTS updating tree for move " << game.recent_move(i).DebugString();
+    //  VLOG(1) << " current tree_: " << root->DebugString();
+    if (!root->expanded.load()) {
       // TODO(piotrf): re-enable vlog once absl supports it
       //  VLOG(1) << "MCTS tree ran out while updating nodes";
-      tree_ = std::make_unique<Node>();
+      root = nullptr;
       break;
     }
     bool found_match = false;
-    for (std::unique_ptr<Node>& child : tree_->children) {
+    const MoveId move = ToMoveId(game.recent_move(i));
+    for (int j = 0; j < root->num_children; ++j) {
       // TODO(piotrf): re-enable vlog once absl supports it
-      //  VLOG(2) << "  child: " << child->DebugString();
-      if (child->move == game.moves()[i]) {
+      //  VLOG(2) << "  child: "
+      //          << ToMove(root->child_moves[j], root->child_color)
+      //                 .DebugString();
+      if (root->child_moves[j] == move) {
         // TODO(piotrf): re-enable vlog once absl supports it
         //  VLOG(2) << "    Match found, stopping.";
         found_match = true;
-        tree_ = std::move(child);
-        tree_->parent = nullptr;
+        // The move may have been selected at most once, in which case there
+        // is nothing to keep.
+        root = root->children[j].load();
         break;
       }
     }
-    CHECK(found_match);
+    if (!found_match) {
+      // The tree only has the moves that it generated, so not a pass by a
+      // color that could still move.
+      root = nullptr;
+    }
+  }
+  // Keep the subtree under the new root, and release the rest of the tree.
+  if (root != tree_) {
+    Reroot(root);
+  }
+  tree_num_moves_ = game.num_moves();
+
+  // Positions from before this move can't be reached anymore.
+  if (options_.use_transpositions) {
+    transpositions_.Prune(game.num_moves());
   }
 
   // Expand out the root, in case we didn't find it above.
-  if (tree_->children.empty()) {
-    ExpandNode(game, tree_.get());
+  if (!tree_->expanded.load()) {
+    ExpandNode(game, tree_, options_.use_transpositions,
+               &arenas_[generation_][0]);
   }
-  CHECK_GT(tree_->children.size(), 0);
+  CHECK_GT(tree_->num_children, 0);
+}
+
+int MctsAI::Search(const Game& game, absl::Time deadline, bool stop_early,
+                   std::atomic<bool>* stop) {
+  const absl::Time start = absl::Now();
+  // Iterations are claimed from `counter` in batches, and counted in
+  // `num_iterations` once they have run.
+  std::atomic<int> counter(0);
+  std::atomic<int> num_iterations(0);
+  // Returns true if the best move can't change anymore, once `begin` > 0
+  // iterations have been claimed.
+  const auto decided = [&](int begin) {
+    double unclaimed = options_.num_iterations - begin;
+    if (deadline != absl::InfiniteFuture()) {
+      // Assume the iterations keep coming at the rate so far.
+      const absl::Time now = absl::Now();
+      unclaimed = std::min(
+          unclaimed, begin * absl::FDivDuration(deadline - now, now - start));
+    }
+    // Every worker may also have a batch in flight.
+    const double remaining_visits =
+        (std::max(unclaimed, 0.0) + pool_.num_threads() * kIterationBatch) *
+        options_.num_rollouts_per_iteration;
+    return MoveIsDecided(*tree_, remaining_visits);
+  };
+
+  size_t tree_bytes = 0;
+  for (const Arena& arena : arenas_[generation_]) {
+    tree_bytes += arena.size();
+  }
+  tree_bytes_.store(tree_bytes);
+
+  pool_.Run([&](int i) {
+    Arena* arena = &arenas_[generation_][i];
+    Worker& worker = workers_[i];
+    Game thread_game = game;
+    // Only the game that iterations are made and taken back on lives long
+    // enough to make keeping its legal moves up to date pay off.
+    if (options_.unmake_moves &&
+        game.board().move_generator() == MoveGenerator::kIncremental) {
+      if (worker.legal_moves == nullptr) {
+        worker.legal_moves = std::make_unique<LegalMoves>();
+      }
+      thread_game.AttachLegalMoves(worker.legal_moves.get());
+    }
+    size_t arena_bytes = arena->size();
+    while (!stop->load(std::memory_order_relaxed)) {
+      // Claim a batch of iterations at a time, so the threads don't all
+      // contend on the counter.
+      const int begin = counter.fetch_add(kIterationBatch);
+      if (begin >= options_.num_iterations) return;
+      if (stop_early && begin > 0 && decided(begin)) {
+        stop->store(true, std::memory_order_relaxed);
+        return;
+      }
+      const int end =
+          std::min(begin + kIterationBatch, options_.num_iterations);
+      for (int j = begin; j < end && !stop->load(std::memory_order_relaxed);
+           ++j) {
+        if (options_.unmake_moves) {
+          Iteration(&thread_game, &worker.undo_stack, arena, &worker.rng);
+          // Walk the game back up to the root for the next iteration.
+          while (!worker.undo_stack.empty()) {
+            thread_game.UnmakeMove(worker.undo_stack.back());
+            worker.undo_stack.pop_back();
+          }
+        } else {
+          Game iteration_game = game;
+          Iteration(&iteration_game, &worker.undo_stack, arena, &worker.rng);
+          worker.undo_stack.clear();
+        }
+        num_iterations.fetch_add(1, std::memory_order_relaxed);
+        tree_bytes_.fetch_add(arena->size() - arena_bytes,
+                              std::memory_order_relaxed);
+        arena_bytes = arena->size();
+        // Reading the clock is cheap next to an iteration.
+        if (deadline != absl::InfiniteFuture() && absl::Now() >= deadline) {
+          stop->store(true, std::memory_order_relaxed);
+        }
+      }
+    }
+  });
+  return num_iterations.load();
+}
+
+void MctsAI::StartPondering(const Game& game) {
+  ponder_stop_.store(false);
+  ponder_thread_ = std::thread([this, game]() {
+    Search(game, absl::InfiniteFuture(), /*stop_early=*/false, &ponder_stop_);
+  });
+}
+
+void MctsAI::StopPondering() {
+  if (!ponder_thread_.joinable()) return;
+  ponder_stop_.store(true);
+  ponder_thread_.join();
+}
+
+Move MctsAI::SelectMove(const Game& game) {
+  const absl::Time start = absl::Now();
+  const absl::Time deadline = start + MoveBudget(game);
+
+  // Unless this is our first move, update tree based on last moves.
+  StopPondering();
+  FollowMoves(game);
 
   // If there is only a single move available, take it. In theory, we could
   // spend some time planning for future moves, but:
-  //   1) we're not playing in a timed environment.
+  //   1) with a game budget, the time is left for the moves that need it.
   //   2) it's rare that a single move will lead to many future moves.
-  if (tree_->children.size() == 1) {
-    tree_ = std::move(tree_->children[0]);
-    return tree_->move;
-  }
-
-  // Run MCTS iterations.
-  {
-    // Launch all worker threads.
-    std::vector<std::thread> workers;
-    std::atomic<int> counter(0);
-    for (int i = 0; i < options_.num_threads; ++i) {
-      workers.emplace_back([&]() {
-        while(true) {
-          if (counter.fetch_add(1) >= options_.num_iterations) return;
-          Iteration(game);
-        }
-      });
-    }
-    // Join worker threads.
-    for (std::thread& worker : workers) {
-      worker.join();
-    }
+  if (tree_->num_children == 1) {
+    num_iterations_ = 0;
+    const Move move = ToMove(tree_->child_moves[0], tree_->child_color);
+    RerootInBackground(GetOrCreateChild(tree_, 0, &arenas_[generation_][0]));
+    ++tree_num_moves_;
+    time_used_ += absl::Now() - start;
+    return move;
   }
 
+  // Run MCTS iterations on all workers, until they have run num_iterations,
+  // time is up, or the move is decided.
+  std::atomic<bool> stop(false);
+  num_iterations_ = Search(game, deadline, options_.stop_early, &stop);
+
   // Pick the best move.
   // TODO(piotrf): re-enable vlog once absl supports it
-  //  VLOG(1) << "MCTS picking from " << tree_->children.size() << " moves.";
+  //  VLOG(1) << "MCTS picking from " << tree_->num_children << " moves.";
   int max_visits = 0;
-  std::unique_ptr<Node>* best_child = nullptr;
-  for (std::unique_ptr<Node>& child : tree_->children) {
+  int best_child = -1;
+  for (int i = 0; i < tree_->num_children; ++i) {
     // TODO(piotrf): re-enable vlog once absl supports it
-    //  VLOG(2) << child->DebugString();
-    if (child->visits > max_visits) {
-      max_visits = child->visits;
-      best_child = &child;
+    //  VLOG(2) << ToMove(tree_->child_moves[i], tree_->child_color)
+    //                 .DebugString();
+    if (tree_->child_visits[i] > max_visits) {
+      max_visits = tree_->child_visits[i];
+      best_child = i;
     }
   }
-  CHECK(best_child != nullptr);
+  CHECK_GE(best_child, 0);
   // TODO(piotrf): re-enable vlog once absl supports it
   //  VLOG(0) << "player " << player_id() << " estimate of winning = "
-  //          << static_cast<double>((*best_child)->wins) / (*best_child)->visits;
-  tree_ = std::move(*best_child);
-  return tree_->move;
+  //          << static_cast<double>(tree_->child_wins[best_child]) /
+  //                 max_visits;
+  // The rest of the tree is released in the background.
+  const Move move =
+      ToMove(tree_->child_moves[best_child], tree_->child_color);
+  RerootInBackground(
+      GetOrCreateChild(tree_, best_child, &arenas_[generation_][0]));
+  ++tree_num_moves_;
+  time_used_ += absl::Now() - start;
+  return move;
+}
+
+void MctsAI::MoveMade(const Game& game, const Move& /*move*/) {
+  if (!options_.ponder) return;
+  StopPondering();
+  if (game.Finished()) return;
+  FollowMoves(game);
+  StartPondering(game);
 }
 
 }  // namespace blokus
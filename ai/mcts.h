@@ -1,18 +1,28 @@
 #ifndef BLOKUS_AI_MCTS_H
 #define BLOKUS_AI_MCTS_H
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
-#include <mutex>
 #include <set>
 #include <string>
+#include <thread>
+#include <vector>
 
+#include "absl/time/time.h"
+
+#include "ai/arena.h"
+#include "ai/thread_pool.h"
+#include "ai/transposition_table.h"
 #include "game/player.h"
+#include "game/rng.h"
 
 namespace blokus {
 
-// Computes a rollout of the given game, using random actions for all players
-// moves. Returns the id of the winning player.
-int Rollout(Game game);
+// Computes a rollout of the given game, using random actions drawn from `rng`
+// for all players moves. Returns the id of the winning player.
+int Rollout(Game game, Rng* rng);
 
 struct MctsOptions {
   // The exploration parameter for UCB1.
@@ -22,14 +32,63 @@ struct MctsOptions {
 
   // The number of iterations of MCTS to run per move, with each iteration
   // consisting of selection of a leaf node, expansion of that node, rollout,
-  // and backpropogation of rollout results.
+  // and backpropogation of rollout results. With a time budget, this is the
+  // most iterations a move may run.
   int num_iterations = 10000;
 
+  // If positive, each move stops searching once this much time has passed.
+  absl::Duration time_per_move = absl::ZeroDuration();
+
+  // If positive, the time the AI may spend on all of its moves in a game. Each
+  // move gets an equal share of the time that is left for every tile the AI
+  // can still play, so moves get more time as tiles run out of room. With
+  // time_per_move as well, the tighter of the two limits applies.
+  absl::Duration time_per_game = absl::ZeroDuration();
+
+  // If true, the search stops as soon as the most visited move can't be
+  // overtaken by the iterations that are left, since those couldn't change
+  // the move that is played. With a time budget, the iterations that are left
+  // are estimated from the rate so far.
+  bool stop_early = true;
+
+  // If true, the AI keeps searching from the current position between its
+  // turns, with the same threads, until the next move is made. Each position
+  // gets up to num_iterations iterations. Only works when the AI is told about
+  // every move, see Player::MoveMade.
+  bool ponder = false;
+
+  // If positive, the tree stops growing once its nodes, together with the
+  // positions in the transposition table, take this many bytes, and
+  // iterations only update the statistics of the moves already in it. When
+  // the tree moves on to the next position, the most visited nodes are kept,
+  // up to half of this, to leave room for the next search. Together with the
+  // part of the tree that is released, the AI may hold about twice this.
+  size_t max_tree_bytes = 0;
+
   // The number of random rollouts to run per MCTS iteration.
   int num_rollouts_per_iteration = 1;
 
-  // The number of parallel threads that are running iterations.
+  // The number of parallel threads that are running iterations. The threads
+  // are started once, and kept for all moves of the AI.
   int num_threads = 1;
+
+  // If true, each thread keeps a single copy of the game, and takes back the
+  // moves made during selection at the end of every iteration. Otherwise the
+  // game is copied for every iteration.
+  bool unmake_moves = true;
+
+  // If true, statistics are shared between all nodes that reach the same
+  // position, no matter the order of moves that led there. In 4 color games,
+  // moves in different parts of the board commute, so this lets a rollout
+  // through one move order inform all the others.
+  bool use_transpositions = false;
+
+  // Seeds the random numbers used for rollouts and for breaking ties during
+  // selection. Each worker thread draws from its own stream of this seed.
+  // Only searches with a single thread, no time budget and no pondering are
+  // reproducible, since otherwise the order and number of iterations depend
+  // on timing.
+  uint64_t seed = 0;
 };
 
 struct Node;
@@ -41,14 +100,110 @@ class MctsAI : public Player {
   ~MctsAI();
 
   Move SelectMove(const Game& board) override;
+  void MoveMade(const Game& game, const Move& move) override;
+
+  // Returns the number of times a node in the tree reached a position that
+  // was already reached by a different node. Only counted with
+  // MctsOptions::use_transpositions.
+  int64_t num_transpositions() const { return num_transpositions_; }
+
+  // Returns the number of iterations that the last SelectMove ran, not
+  // counting the ones from pondering.
+  int num_iterations() const { return num_iterations_; }
+
+  // Returns the bytes that count toward MctsOptions::max_tree_bytes, as of the
+  // end of the last search.
+  size_t tree_bytes() const { return tree_bytes_ + transpositions_.bytes(); }
 
  private:
-  void Iteration(Game game);
+  // Runs a single MCTS iteration starting from `game`, which must be at the
+  // root of the tree. The moves made during selection are left on `game`, and
+  // the information needed to take them back is appended to `undo_stack`.
+  // Nodes are allocated from `arena`, and random numbers drawn from `rng`, both
+  // owned by the calling thread.
+  void Iteration(Game* game, std::vector<Game::Undo>* undo_stack,
+                 Arena* arena, Rng* rng);
+
+  // Makes a copy of `root` and its subtree the new tree, and releases
+  // everything else. If `root` is null, starts a new tree.
+  void Reroot(const Node* root);
+
+  // Like Reroot, but on a background thread, so that copying the tree doesn't
+  // hold up the move. The tree must not be used until WaitForReroot returns.
+  void RerootInBackground(Node* root);
+  void WaitForReroot();
+
+  // Moves the root of the tree down to `game`, following the moves made since
+  // the root, and expands it. If the tree doesn't have them, starts a new
+  // tree instead.
+  void FollowMoves(const Game& game);
+
+  // Runs iterations from the root of the tree, which must be at `game`, on all
+  // workers until they have run num_iterations or `stop` is set. `stop` is set
+  // at the `deadline`, and with `stop_early` once the best move is decided.
+  // Returns the number of iterations run.
+  int Search(const Game& game, absl::Time deadline, bool stop_early,
+              std::atomic<bool>* stop);
+
+  // Starts searching from `game` in the background, for
+  // MctsOptions::ponder.
+  void StartPondering(const Game& game);
+  // Waits for the background search to stop, if there is one.
+  void StopPondering();
+
+  // Returns how long the search for the move in `game` may take, or
+  // absl::InfiniteDuration() if there is no time budget.
+  absl::Duration MoveBudget(const Game& game) const;
+
+  // Scratch state that a worker thread keeps from one move to the next. Each
+  // gets its own cache line, since the random state changes on every draw.
+  struct alignas(64) Worker {
+    explicit Worker(const Rng& rng) : rng(rng) {}
+
+    Rng rng;
+    std::vector<Game::Undo> undo_stack;
+    // Where the worker's game keeps its legal moves with the incremental move
+    // generator, allocated by the first search that needs it.
+    std::unique_ptr<LegalMoves> legal_moves;
+  };
 
   MctsOptions options_;
 
-  std::mutex tree_mutex_;
-  std::unique_ptr<Node> tree_;
+  // Nodes are allocated from one arena per worker thread, in two generations.
+  // The tree lives in the current generation. Rerooting copies the subtree
+  // that is kept to the other generation, then releases the current one all
+  // at once.
+  std::vector<Arena> arenas_[2];
+  int generation_ = 0;
+
+  // The root of the tree, and the number of moves made in the game at the
+  // root.
+  Node* tree_ = nullptr;
+  int tree_num_moves_ = 0;
+
+  // The bytes taken by the tree, counted during the search for
+  // MctsOptions::max_tree_bytes. The transposition table counts its own.
+  std::atomic<size_t> tree_bytes_ = 0;
+
+  // Statistics per position, used with MctsOptions::use_transpositions.
+  TranspositionTable transpositions_;
+  std::atomic<int64_t> num_transpositions_ = 0;
+  int num_iterations_ = 0;
+
+  // The time spent in SelectMove so far, for MctsOptions::time_per_game.
+  absl::Duration time_used_ = absl::ZeroDuration();
+
+  // One per thread of the pool. Worker 0 is the thread calling SelectMove.
+  std::vector<Worker> workers_;
+  ThreadPool pool_;
+
+  // Runs the search in the background with MctsOptions::ponder, and calls
+  // ThreadPool::Run on it, until ponder_stop_ is set.
+  std::thread ponder_thread_;
+  std::atomic<bool> ponder_stop_ = false;
+
+  // Runs RerootInBackground.
+  std::thread reroot_thread_;
 };
   
 }  // namespace blokus
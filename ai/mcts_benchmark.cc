@@ -7,6 +7,7 @@
 //   $ pprof -http=":8000" bazel-bin/ai/mcts_benchmark /tmp/mcts_benchmark.prof
 #include "ai/mcts.h"
 
+#include "absl/log/check.h"
 #include "benchmark/benchmark.h"
 
 namespace blokus {
@@ -25,9 +26,10 @@ namespace {
 // BM_Rollout     932193 ns       932172 ns          728  (possible tile cache)
 
 static void BM_Rollout(benchmark::State& state) {
+  Rng rng(0);
   for (auto _ : state) {
     Game game(4);
-    Rollout(game);
+    Rollout(game, &rng);
   }
 }
 BENCHMARK(BM_Rollout);
@@ -38,13 +40,40 @@ static void BM_SelectMove(benchmark::State& state) {
     MctsOptions options{
       .num_iterations = state.range(0),
       .num_threads = 8,
+      .unmake_moves = state.range(1) != 0,
     };
     MctsAI ai(0, options);
     ai.SelectMove(game);
     state.SetItemsProcessed(state.range(0));
   }      
 }
-BENCHMARK(BM_SelectMove)->Arg(10000);
+BENCHMARK(BM_SelectMove)->Args({10000, 0})->Args({10000, 1});
+
+// Searches a position where only blue is still playing, so that all of blue's
+// moves commute. This is the best case for sharing statistics between
+// transposed positions.
+static void BM_SelectMoveTranspositions(benchmark::State& state) {
+  Game game(4);
+  CHECK(game.MakeMove(game.PossibleMoves().back()));
+  for (int i = 0; i < 3; ++i) {
+    CHECK(game.MakeMove(Move::EmptyMove(game.current_color())));
+  }
+  int64_t num_transpositions = 0;
+  for (auto _ : state) {
+    MctsOptions options{
+      .num_iterations = static_cast<int>(state.range(0)),
+      .num_threads = 8,
+      .use_transpositions = state.range(1) != 0,
+    };
+    MctsAI ai(0, options);
+    ai.SelectMove(game);
+    num_transpositions += ai.num_transpositions();
+    state.SetItemsProcessed(state.range(0));
+  }
+  state.counters["transpositions"] = benchmark::Counter(
+      num_transpositions, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_SelectMoveTranspositions)->Args({10000, 0})->Args({10000, 1});
 
 }  // namespace
 }  // namespace blokus
@@ -0,0 +1,224 @@
+#include "ai/mcts.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include "game/game.h"
+#include "game/rng.h"
+
+namespace blokus {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Ge;
+using ::testing::Gt;
+using ::testing::Lt;
+
+// Plays the first `num_moves` moves of a 4 player game between MctsAIs with
+// the given options, telling every AI about every move like GameRunner does.
+// Returns the moves that were played.
+std::vector<std::string> PlayMoves(const MctsOptions& options, int num_moves) {
+  std::vector<std::unique_ptr<MctsAI>> ais;
+  for (int player = 0; player < 4; ++player) {
+    ais.push_back(std::make_unique<MctsAI>(player, options));
+  }
+  Game game(4);
+  std::vector<std::string> moves;
+  for (int i = 0; i < num_moves; ++i) {
+    const Move move = ais[game.current_player()]->SelectMove(game);
+    EXPECT_TRUE(game.MakeMove(move)) << move.DebugString();
+    for (const std::unique_ptr<MctsAI>& ai : ais) {
+      ai->MoveMade(game, move);
+    }
+    moves.push_back(move.DebugString());
+  }
+  return moves;
+}
+
+TEST(MctsTest, SingleThreadedSearchesRepeatWithSameSeed) {
+  for (bool unmake_moves : {false, true}) {
+    const MctsOptions options{
+        .num_iterations = 100,
+        .num_threads = 1,
+        .unmake_moves = unmake_moves,
+        .seed = 17,
+    };
+    EXPECT_THAT(PlayMoves(options, 6), Eq(PlayMoves(options, 6)));
+  }
+}
+
+TEST(MctsTest, StopsAtTimePerMove) {
+  const MctsOptions options{
+      .num_iterations = 1 << 30,
+      .time_per_move = absl::Milliseconds(100),
+      .stop_early = false,
+      .num_threads = 2,
+  };
+  MctsAI ai(0, options);
+  Game game(4);
+  const absl::Time start = absl::Now();
+  ai.SelectMove(game);
+  const absl::Duration elapsed = absl::Now() - start;
+  EXPECT_GE(elapsed, absl::Milliseconds(100));
+  // Each thread may finish the iteration it was running at the deadline.
+  EXPECT_LT(elapsed, absl::Milliseconds(500));
+  EXPECT_THAT(ai.num_iterations(), Gt(0));
+}
+
+TEST(MctsTest, SpreadsTimePerGameOverMoves) {
+  const absl::Duration kTimePerGame = absl::Milliseconds(500);
+  const MctsOptions options{
+      .num_iterations = 1 << 30,
+      .time_per_game = kTimePerGame,
+      .stop_early = false,
+  };
+  // Once the time is used up, every move still runs an iteration. None takes
+  // longer than one from the start position, which is slower on slow builds.
+  MctsOptions one_iteration = options;
+  one_iteration.num_iterations = 1;
+  one_iteration.time_per_game = absl::ZeroDuration();
+  absl::Duration iteration_time;
+  for (int i = 0; i < 3; ++i) {
+    MctsAI ai(0, one_iteration);
+    const absl::Time start = absl::Now();
+    ai.SelectMove(Game(2));
+    iteration_time = std::max(iteration_time, absl::Now() - start);
+  }
+
+  MctsAI ais[2] = {MctsAI(0, options), MctsAI(1, options)};
+  absl::Duration time_used[2];
+  int num_moves[2] = {};
+  Game game(2);
+  while (!game.Finished()) {
+    const int player = game.current_player();
+    const absl::Time start = absl::Now();
+    const Move move = ais[player].SelectMove(game);
+    time_used[player] += absl::Now() - start;
+    ++num_moves[player];
+    ASSERT_TRUE(game.MakeMove(move));
+  }
+  for (int player = 0; player < 2; ++player) {
+    EXPECT_LT(time_used[player], kTimePerGame +
+                                     num_moves[player] * iteration_time +
+                                     absl::Milliseconds(250))
+        << num_moves[player] << " moves, " << iteration_time
+        << " per iteration";
+  }
+}
+
+TEST(MctsTest, FollowsPassesOfColorsThatCouldMove) {
+  const MctsOptions options{
+      .num_iterations = 200,
+      .num_threads = 1,
+  };
+  MctsAI ai(0, options);
+  Game game(4);
+  ASSERT_TRUE(game.MakeMove(ai.SelectMove(game)));
+  // The search never tries passing while there are moves, but players may.
+  ASSERT_TRUE(game.MakeMove(Move::EmptyMove(game.current_color())));
+  Rng rng(5);
+  while (game.current_player() != 0) {
+    ASSERT_TRUE(game.MakeMove(ToMove(game.SampleMove(&rng),
+                                     game.current_color())));
+  }
+  EXPECT_TRUE(game.MakeMove(ai.SelectMove(game)));
+}
+
+TEST(MctsTest, StopsEarlyOnceMoveIsDecided) {
+  // Get to a position where the player has only a few moves to choose from.
+  Rng rng(3);
+  Game game(2);
+  while (game.num_moves() < 20 || game.CountMoves() < 2 ||
+         game.CountMoves() > 4) {
+    ASSERT_TRUE(game.MakeMove(ToMove(game.SampleMove(&rng),
+                                     game.current_color())));
+    ASSERT_FALSE(game.Finished());
+  }
+
+  const int kNumIterations = 4000;
+  MctsOptions options{
+      .num_iterations = kNumIterations,
+      .num_threads = 1,
+  };
+  MctsAI eager(game.current_player(), options);
+  const Move eager_move = eager.SelectMove(game);
+  EXPECT_THAT(eager.num_iterations(), Lt(kNumIterations));
+
+  // Running the rest of the iterations doesn't change the move.
+  options.stop_early = false;
+  MctsAI thorough(game.current_player(), options);
+  EXPECT_THAT(thorough.SelectMove(game), Eq(eager_move));
+  EXPECT_THAT(thorough.num_iterations(), Eq(kNumIterations));
+}
+
+TEST(MctsTest, StopsPonderingWhenMovesArrive) {
+  // Left alone, the pondering AI would search forever, so generous timeouts
+  // still catch it not stopping, even on slow builds.
+  const absl::Duration kTimeout = absl::Seconds(5);
+  const MctsOptions ponder_options{
+      .num_iterations = 1 << 30,
+      .time_per_move = absl::Milliseconds(50),
+      .ponder = true,
+      .num_threads = 2,
+  };
+  const MctsOptions options{
+      .num_iterations = 50,
+      .num_threads = 1,
+  };
+  std::vector<std::unique_ptr<MctsAI>> ais;
+  ais.push_back(std::make_unique<MctsAI>(0, ponder_options));
+  for (int player = 1; player < 4; ++player) {
+    ais.push_back(std::make_unique<MctsAI>(player, options));
+  }
+
+  Game game(4);
+  for (int i = 0; i < 12; ++i) {
+    absl::Time start = absl::Now();
+    const Move move = ais[game.current_player()]->SelectMove(game);
+    EXPECT_LT(absl::Now() - start, kTimeout);
+    ASSERT_TRUE(game.MakeMove(move));
+    // Each move stops the search and starts the next one.
+    for (const std::unique_ptr<MctsAI>& ai : ais) {
+      start = absl::Now();
+      ai->MoveMade(game, move);
+      EXPECT_LT(absl::Now() - start, kTimeout);
+    }
+    absl::SleepFor(absl::Milliseconds(20));
+  }
+
+  // So does destroying the AI.
+  const absl::Time start = absl::Now();
+  ais[0].reset();
+  EXPECT_LT(absl::Now() - start, kTimeout);
+}
+
+TEST(MctsTest, TreeStopsGrowingAtMaxTreeBytes) {
+  const size_t kMaxTreeBytes = 64 << 10;
+  for (bool use_transpositions : {false, true}) {
+    const MctsOptions options{
+        .num_iterations = 1000,
+        .stop_early = false,
+        .max_tree_bytes = kMaxTreeBytes,
+        .num_threads = 2,
+        .use_transpositions = use_transpositions,
+    };
+    MctsAI ai(0, options);
+    Game game(4);
+    ai.SelectMove(game);
+    EXPECT_THAT(ai.num_iterations(), Eq(1000));
+    EXPECT_THAT(ai.tree_bytes(), Ge(kMaxTreeBytes));
+    // Each thread may expand one more node after the tree is full, which
+    // takes a few KB this early in the game.
+    EXPECT_THAT(ai.tree_bytes(), Lt(kMaxTreeBytes + 2 * (16 << 10)));
+  }
+}
+
+}  // namespace
+}  // namespace blokus
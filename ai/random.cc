@@ -3,13 +3,13 @@
 namespace blokus {
 
 Move RandomAI::SelectMove(const Game& game) {
-  std::vector<Move> moves = game.PossibleMoves();
-  if (moves.size() > 0) {
-    const Move& move = moves[rand() % moves.size()];
-    played_tiles_.insert(move.tile);
-    return move;
+  const MoveId move_id = game.SampleMove(&rng_);
+  if (move_id == kPassMoveId) {
+    return Move::EmptyMove(game.current_color());
   }
-  return Move::EmptyMove(game.current_color());
+  const Move move = ToMove(move_id, game.current_color());
+  played_tiles_.insert(move.tile);
+  return move;
 }
 
 }  // namespace blokus
@@ -4,18 +4,22 @@
 #include <set>
 
 #include "game/player.h"
+#include "game/rng.h"
 
 namespace blokus {
 
 // An AI that just plays a random move from the set of possible moves.
 class RandomAI : public Player {
  public:
-  explicit RandomAI(int player_id) : Player(player_id) {}
+  // Players with the same `seed` draw from different streams of it.
+  explicit RandomAI(int player_id, uint64_t seed = 0)
+      : Player(player_id), rng_(seed, player_id) {}
 
   Move SelectMove(const Game& game) override;
 
  private:
   std::set<int> played_tiles_;
+  Rng rng_;
 };
 
 }  // namespace blokus
@@ -0,0 +1,70 @@
+#include "ai/thread_pool.h"
+
+#include "absl/log/check.h"
+
+namespace blokus {
+
+ThreadPool::ThreadPool(int num_threads) {
+  CHECK_GE(num_threads, 1);
+  for (int i = 1; i < num_threads; ++i) {
+    threads_.emplace_back([this, i]() { WorkerLoop(i); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  start_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+}
+
+void ThreadPool::Run(const std::function<void(int)>& fn) {
+  if (!threads_.empty()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      CHECK_EQ(num_running_, 0) << "ThreadPool::Run is not reentrant";
+      fn_ = &fn;
+      num_running_ = threads_.size();
+      ++generation_;
+    }
+    start_.notify_all();
+  }
+
+  fn(0);
+
+  if (!threads_.empty()) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this]() { return num_running_ == 0; });
+    fn_ = nullptr;
+  }
+}
+
+void ThreadPool::WorkerLoop(int worker) {
+  uint64_t generation = 0;
+  while (true) {
+    const std::function<void(int)>* fn;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_.wait(lock, [&]() {
+        return stopping_ || generation_ != generation;
+      });
+      if (stopping_) return;
+      generation = generation_;
+      fn = fn_;
+    }
+
+    (*fn)(worker);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--num_running_ > 0) continue;
+    }
+    done_.notify_one();
+  }
+}
+
+}  // namespace blokus
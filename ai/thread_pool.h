@@ -0,0 +1,53 @@
+#ifndef BLOKUS_AI_THREAD_POOL_H
+#define BLOKUS_AI_THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace blokus {
+
+// A fixed set of threads that live as long as the pool, so that running work
+// on all of them doesn't pay for starting and joining threads every time.
+//
+// The thread that calls Run takes part as worker 0, so a pool of one thread
+// doesn't start any threads at all.
+class ThreadPool {
+ public:
+  explicit ThreadPool(int num_threads);
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+  ~ThreadPool();
+
+  int num_threads() const { return threads_.size() + 1; }
+
+  // Calls `fn(i)` once for every worker i in [0, num_threads()), each on its
+  // own thread, and returns once all of the calls have returned. Only one Run
+  // may be in progress at a time.
+  void Run(const std::function<void(int)>& fn);
+
+ private:
+  void WorkerLoop(int worker);
+
+  std::mutex mutex_;
+  // Signals the workers that there is a new function to run, or that they
+  // should stop.
+  std::condition_variable start_;
+  // Signals Run that the last worker is done.
+  std::condition_variable done_;
+  const std::function<void(int)>* fn_ = nullptr;
+  // Incremented by every Run, so workers can tell new work from old.
+  uint64_t generation_ = 0;
+  // The number of pool threads still running the current function.
+  int num_running_ = 0;
+  bool stopping_ = false;
+
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace blokus
+
+#endif
@@ -0,0 +1,69 @@
+#include "ai/thread_pool.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace blokus {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Ne;
+
+TEST(ThreadPoolTest, RunsEveryWorkerOnce) {
+  ThreadPool pool(4);
+  EXPECT_THAT(pool.num_threads(), Eq(4));
+  std::vector<std::atomic<int>> runs(4);
+  pool.Run([&](int i) { ++runs[i]; });
+  for (const std::atomic<int>& count : runs) {
+    EXPECT_THAT(count.load(), Eq(1));
+  }
+}
+
+TEST(ThreadPoolTest, OneThreadRunsOnCaller) {
+  ThreadPool pool(1);
+  EXPECT_THAT(pool.num_threads(), Eq(1));
+  std::thread::id id;
+  pool.Run([&](int i) {
+    EXPECT_THAT(i, Eq(0));
+    id = std::this_thread::get_id();
+  });
+  EXPECT_THAT(id, Eq(std::this_thread::get_id()));
+}
+
+TEST(ThreadPoolTest, ReusesThreadsAcrossRuns) {
+  const int kNumThreads = 4;
+  const int kNumRuns = 100;
+  ThreadPool pool(kNumThreads);
+
+  std::vector<std::thread::id> first_ids(kNumThreads);
+  pool.Run([&](int i) { first_ids[i] = std::this_thread::get_id(); });
+  EXPECT_THAT(first_ids[0], Eq(std::this_thread::get_id()));
+  for (int i = 1; i < kNumThreads; ++i) {
+    EXPECT_THAT(first_ids[i], Ne(std::this_thread::get_id()));
+    for (int j = 1; j < i; ++j) {
+      EXPECT_THAT(first_ids[i], Ne(first_ids[j]));
+    }
+  }
+
+  // Every later run sees the same threads, and all of its work is done when
+  // Run returns.
+  std::vector<std::atomic<int>> runs(kNumThreads);
+  for (int run = 0; run < kNumRuns; ++run) {
+    std::vector<std::thread::id> ids(kNumThreads);
+    pool.Run([&](int i) {
+      ids[i] = std::this_thread::get_id();
+      ++runs[i];
+    });
+    ASSERT_THAT(ids, Eq(first_ids));
+    for (const std::atomic<int>& count : runs) {
+      ASSERT_THAT(count.load(), Eq(run + 1));
+    }
+  }
+}
+
+}  // namespace
+}  // namespace blokus
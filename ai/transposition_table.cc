@@ -0,0 +1,33 @@
+#include "ai/transposition_table.h"
+
+namespace blokus {
+
+PositionStats* TranspositionTable::Lookup(uint64_t hash, int num_moves,
+                                          bool* found) {
+  // The low bits of the hash pick the bucket inside a shard, so use the high
+  // bits to pick the shard.
+  Shard& shard = shards_[hash >> 58];
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto [it, inserted] = shard.stats.try_emplace(hash);
+  if (inserted) {
+    it->second.num_moves = num_moves;
+    size_.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (found != nullptr) {
+    *found = !inserted;
+  }
+  return &it->second;
+}
+
+void TranspositionTable::Prune(int num_moves) {
+  for (Shard& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    const size_t num_erased =
+        absl::erase_if(shard.stats, [num_moves](const auto& entry) {
+          return entry.second.num_moves < num_moves;
+        });
+    size_.fetch_sub(num_erased, std::memory_order_relaxed);
+  }
+}
+
+}  // namespace blokus
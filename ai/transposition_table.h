@@ -0,0 +1,75 @@
+#ifndef BLOKUS_AI_TRANSPOSITION_TABLE_H
+#define BLOKUS_AI_TRANSPOSITION_TABLE_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "absl/container/node_hash_map.h"
+
+namespace blokus {
+
+// MCTS statistics for a single position, shared by every node in the search
+// tree that reaches it, no matter the order of moves that led there.
+struct PositionStats {
+  // The number of wins for the player that moved into this position.
+  std::atomic<int> wins = 0;
+
+  // The number of rollouts that have passed through this position.
+  std::atomic<int> visits = 0;
+
+  // The number of moves played in the game to reach this position.
+  int num_moves = 0;
+};
+
+// A map from position hash (see Game::hash) to PositionStats that can be used
+// from multiple threads. The map is split into shards with their own lock, so
+// threads only contend when they look up positions in the same shard.
+//
+// Entries are never moved, so returned pointers stay valid until the entry is
+// removed by Prune.
+class TranspositionTable {
+ public:
+  TranspositionTable() = default;
+  TranspositionTable(const TranspositionTable&) = delete;
+  TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+  // Returns the stats for the position with the given hash, creating them if
+  // needed. `num_moves` is only used for new entries. If `found` is not null,
+  // it is set to whether the entry already existed.
+  PositionStats* Lookup(uint64_t hash, int num_moves, bool* found = nullptr);
+
+  // Removes all positions with fewer than `num_moves` moves. These can't be
+  // reached anymore once the game has progressed past them.
+  void Prune(int num_moves);
+
+  // Returns the number of positions in the table.
+  size_t size() const { return size_.load(std::memory_order_relaxed); }
+
+  // Returns about how many bytes the positions in the table take.
+  size_t bytes() const { return size() * kBytesPerPosition; }
+
+ private:
+  // Every entry is allocated on its own, and the map keeps a pointer and a
+  // control byte per bucket, with up to about two buckets per entry.
+  static constexpr size_t kBytesPerPosition =
+      sizeof(std::pair<const uint64_t, PositionStats>) + 2 * sizeof(void*) +
+      2 * (sizeof(void*) + 1);
+
+  static constexpr int kNumShards = 64;
+
+  struct Shard {
+    mutable std::mutex mutex;
+    absl::node_hash_map<uint64_t, PositionStats> stats;
+  };
+
+  std::array<Shard, kNumShards> shards_;
+  std::atomic<size_t> size_ = 0;
+};
+
+}  // namespace blokus
+
+#endif
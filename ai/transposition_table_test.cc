@@ -0,0 +1,119 @@
+#include "ai/transposition_table.h"
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace blokus {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Ge;
+using ::testing::Ne;
+
+// Returns a hash that lands in the given shard, since the table picks shards
+// by the high bits of the hash.
+uint64_t HashInShard(int shard, int i) {
+  return uint64_t(shard) << 58 | uint64_t(i);
+}
+
+TEST(TranspositionTableTest, LookupCreatesEntriesOnce) {
+  TranspositionTable table;
+  bool found = true;
+  PositionStats* stats = table.Lookup(42, 3, &found);
+  ASSERT_THAT(stats, Ne(nullptr));
+  EXPECT_FALSE(found);
+  EXPECT_THAT(stats->num_moves, Eq(3));
+  EXPECT_THAT(stats->visits.load(), Eq(0));
+  EXPECT_THAT(stats->wins.load(), Eq(0));
+  stats->visits = 5;
+
+  // The second lookup finds the same entry, and leaves num_moves alone.
+  EXPECT_THAT(table.Lookup(42, 7, &found), Eq(stats));
+  EXPECT_TRUE(found);
+  EXPECT_THAT(stats->num_moves, Eq(3));
+  EXPECT_THAT(stats->visits.load(), Eq(5));
+  EXPECT_THAT(table.Lookup(42, 3), Eq(stats));
+
+  EXPECT_THAT(table.Lookup(43, 3, &found), Ne(stats));
+  EXPECT_FALSE(found);
+  EXPECT_THAT(table.size(), Eq(2));
+}
+
+TEST(TranspositionTableTest, SizeAndBytesCoverAllShards) {
+  TranspositionTable table;
+  EXPECT_THAT(table.size(), Eq(0));
+  EXPECT_THAT(table.bytes(), Eq(0));
+  for (int shard = 0; shard < 64; ++shard) {
+    for (int i = 0; i < 10; ++i) {
+      table.Lookup(HashInShard(shard, i), 0);
+    }
+  }
+  EXPECT_THAT(table.size(), Eq(640));
+  EXPECT_THAT(table.bytes(), Ge(640 * sizeof(PositionStats)));
+}
+
+TEST(TranspositionTableTest, PruneRemovesEarlierPositionsFromAllShards) {
+  TranspositionTable table;
+  std::vector<PositionStats*> kept;
+  for (int shard = 0; shard < 64; ++shard) {
+    for (int num_moves = 0; num_moves < 4; ++num_moves) {
+      PositionStats* stats =
+          table.Lookup(HashInShard(shard, num_moves), num_moves);
+      stats->visits = shard;
+      if (num_moves >= 2) kept.push_back(stats);
+    }
+  }
+  EXPECT_THAT(table.size(), Eq(256));
+  const size_t bytes = table.bytes();
+
+  table.Prune(2);
+  EXPECT_THAT(table.size(), Eq(128));
+  EXPECT_THAT(table.bytes(), Eq(bytes / 2));
+  for (int shard = 0; shard < 64; ++shard) {
+    for (int num_moves = 0; num_moves < 4; ++num_moves) {
+      bool found = false;
+      PositionStats* stats =
+          table.Lookup(HashInShard(shard, num_moves), num_moves, &found);
+      EXPECT_THAT(found, Eq(num_moves >= 2)) << shard << " " << num_moves;
+      if (num_moves < 2) continue;
+      // Entries that are kept don't move.
+      EXPECT_THAT(stats, Eq(kept[2 * shard + num_moves - 2]));
+      EXPECT_THAT(stats->visits.load(), Eq(shard));
+    }
+  }
+}
+
+TEST(TranspositionTableTest, ThreadsShareEntries) {
+  const int kNumThreads = 4;
+  const int kNumPositions = 1000;
+  TranspositionTable table;
+  std::vector<std::vector<PositionStats*>> found(kNumThreads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < kNumPositions; ++i) {
+        PositionStats* stats = table.Lookup(HashInShard(i % 64, i), 0);
+        stats->visits.fetch_add(1);
+        found[t].push_back(stats);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_THAT(table.size(), Eq(kNumPositions));
+  for (int t = 1; t < kNumThreads; ++t) {
+    EXPECT_THAT(found[t], Eq(found[0]));
+  }
+  for (PositionStats* stats : found[0]) {
+    ASSERT_THAT(stats->visits.load(), Eq(kNumThreads));
+  }
+}
+
+}  // namespace
+}  // namespace blokus
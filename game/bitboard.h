@@ -0,0 +1,261 @@
+#ifndef BLOKUS_GAME_BITBOARD_H_
+#define BLOKUS_GAME_BITBOARD_H_
+
+#include <cstdint>
+
+namespace blokus {
+
+// A set of cells on the board, stored as a flat bitmap.
+//
+// Cell (row, col) corresponds to bit kNumCols * row + col, so the cells of a
+// row are contiguous. Since a row is 20 bits, some rows straddle two words.
+// Bitboard is trivially copyable, so anything built out of them (like Board)
+// can be copied with a single memcpy.
+class Bitboard {
+ public:
+  static constexpr int kNumRows = 20;
+  static constexpr int kNumCols = 20;
+  static constexpr int kNumBits = kNumRows * kNumCols;
+  static constexpr int kNumWords = (kNumBits + 63) / 64;
+  static constexpr uint32_t kRowMask = (1u << kNumCols) - 1;
+
+  // Returns a bitboard with every cell on the board set.
+  static Bitboard Full();
+
+  static constexpr int Index(int row, int col) { return kNumCols * row + col; }
+
+  bool Get(int row, int col) const {
+    const int i = Index(row, col);
+    return (words_[i >> 6] >> (i & 63)) & 1;
+  }
+  void Set(int row, int col) {
+    const int i = Index(row, col);
+    words_[i >> 6] |= uint64_t{1} << (i & 63);
+  }
+  void Clear(int row, int col) {
+    const int i = Index(row, col);
+    words_[i >> 6] &= ~(uint64_t{1} << (i & 63));
+  }
+
+  // Returns the cells of `row` as a bitmap, where the least significant bit
+  // corresponds to column 0.
+  uint32_t Row(int row) const;
+
+  // Sets or clears the given cells of `row`. Bits past kNumCols are ignored.
+  void SetRow(int row, uint32_t bits);
+  void ClearRow(int row, uint32_t bits);
+
+  bool Empty() const;
+
+  // Returns the number of cells in the set.
+  int Count() const;
+
+  // Returns the Index of the `n`th cell of the set in row-major order,
+  // starting from 0. There must be more than `n` cells.
+  int Select(int n) const;
+
+  // Returns true if this and `other` have any cells in common.
+  bool Intersects(const Bitboard& other) const;
+
+  // Returns true if every cell of `other` is also in this set.
+  bool Contains(const Bitboard& other) const;
+
+  // Calls f(row, col) for every cell in the set, in row-major order.
+  template <typename F>
+  void ForEach(F f) const;
+
+  Bitboard& operator&=(const Bitboard& other);
+  Bitboard& operator|=(const Bitboard& other);
+
+  // Returns the cells on the board that are not in this set.
+  Bitboard operator~() const;
+
+  // Shifts the whole bitmap towards bit 0, i.e. cell i of the result is cell
+  // i + n of this bitboard. Shifting by Index(row, col) moves every cell up by
+  // `row` rows and left by `col` columns, although cells in the first `col`
+  // columns wrap around to the end of the previous row.
+  Bitboard operator>>(int n) const;
+
+  // Shifts the whole bitmap away from bit 0, i.e. cell i of the result is cell
+  // i - n of this bitboard. Cells shifted past the end of the board are
+  // dropped.
+  Bitboard operator<<(int n) const;
+
+  // The raw bitmap, with cell i in bit i % 64 of word i / 64. Bits past
+  // kNumBits are always clear.
+  const uint64_t* words() const { return words_; }
+
+  friend bool operator==(const Bitboard& lhs, const Bitboard& rhs);
+
+ private:
+  uint64_t words_[kNumWords] = {};
+};
+
+inline Bitboard Bitboard::Full() {
+  Bitboard b;
+  for (int i = 0; i < kNumWords - 1; ++i) {
+    b.words_[i] = ~uint64_t{0};
+  }
+  b.words_[kNumWords - 1] =
+      (uint64_t{1} << (kNumBits - 64 * (kNumWords - 1))) - 1;
+  return b;
+}
+
+inline uint32_t Bitboard::Row(int row) const {
+  const int bit = kNumCols * row;
+  const int word = bit >> 6;
+  const int offset = bit & 63;
+  // No row starts in the last word, so it is always safe to read the next one.
+  // The double shift avoids an undefined shift by 64 when offset is 0.
+  const uint64_t bits =
+      (words_[word] >> offset) | ((words_[word + 1] << (63 - offset)) << 1);
+  return bits & kRowMask;
+}
+
+inline void Bitboard::SetRow(int row, uint32_t bits) {
+  const uint64_t mask = bits & kRowMask;
+  const int bit = kNumCols * row;
+  const int word = bit >> 6;
+  const int offset = bit & 63;
+  words_[word] |= mask << offset;
+  words_[word + 1] |= (mask >> (63 - offset)) >> 1;
+}
+
+inline void Bitboard::ClearRow(int row, uint32_t bits) {
+  const uint64_t mask = bits & kRowMask;
+  const int bit = kNumCols * row;
+  const int word = bit >> 6;
+  const int offset = bit & 63;
+  words_[word] &= ~(mask << offset);
+  words_[word + 1] &= ~((mask >> (63 - offset)) >> 1);
+}
+
+inline bool Bitboard::Empty() const {
+  uint64_t any = 0;
+  for (int i = 0; i < kNumWords; ++i) {
+    any |= words_[i];
+  }
+  return any == 0;
+}
+
+inline int Bitboard::Count() const {
+  int count = 0;
+  for (int i = 0; i < kNumWords; ++i) {
+    count += __builtin_popcountll(words_[i]);
+  }
+  return count;
+}
+
+inline int Bitboard::Select(int n) const {
+  for (int word = 0; word < kNumWords; ++word) {
+    uint64_t bits = words_[word];
+    const int count = __builtin_popcountll(bits);
+    if (n >= count) {
+      n -= count;
+      continue;
+    }
+    for (; n > 0; --n) {
+      bits &= bits - 1;
+    }
+    return 64 * word + __builtin_ctzll(bits);
+  }
+  return -1;
+}
+
+template <typename F>
+void Bitboard::ForEach(F f) const {
+  for (int word = 0; word < kNumWords; ++word) {
+    uint64_t bits = words_[word];
+    while (bits) {
+      const int i = 64 * word + __builtin_ctzll(bits);
+      f(i / kNumCols, i % kNumCols);
+      bits &= bits - 1;
+    }
+  }
+}
+
+inline Bitboard& Bitboard::operator&=(const Bitboard& other) {
+  for (int i = 0; i < kNumWords; ++i) {
+    words_[i] &= other.words_[i];
+  }
+  return *this;
+}
+
+inline Bitboard& Bitboard::operator|=(const Bitboard& other) {
+  for (int i = 0; i < kNumWords; ++i) {
+    words_[i] |= other.words_[i];
+  }
+  return *this;
+}
+
+inline Bitboard Bitboard::operator~() const {
+  Bitboard b = Full();
+  for (int i = 0; i < kNumWords; ++i) {
+    b.words_[i] &= ~words_[i];
+  }
+  return b;
+}
+
+inline Bitboard Bitboard::operator>>(int n) const {
+  Bitboard b;
+  const int word_shift = n >> 6;
+  const int bit_shift = n & 63;
+  for (int i = 0; i + word_shift < kNumWords; ++i) {
+    uint64_t bits = words_[i + word_shift] >> bit_shift;
+    if (i + word_shift + 1 < kNumWords) {
+      bits |= (words_[i + word_shift + 1] << (63 - bit_shift)) << 1;
+    }
+    b.words_[i] = bits;
+  }
+  return b;
+}
+
+inline Bitboard Bitboard::operator<<(int n) const {
+  Bitboard b;
+  const int word_shift = n >> 6;
+  const int bit_shift = n & 63;
+  for (int i = kNumWords - 1; i >= word_shift; --i) {
+    uint64_t bits = words_[i - word_shift] << bit_shift;
+    if (i - word_shift - 1 >= 0) {
+      bits |= (words_[i - word_shift - 1] >> (63 - bit_shift)) >> 1;
+    }
+    b.words_[i] = bits;
+  }
+  b.words_[kNumWords - 1] &= Full().words_[kNumWords - 1];
+  return b;
+}
+
+inline Bitboard operator&(Bitboard lhs, const Bitboard& rhs) {
+  return lhs &= rhs;
+}
+
+inline Bitboard operator|(Bitboard lhs, const Bitboard& rhs) {
+  return lhs |= rhs;
+}
+
+inline bool Bitboard::Intersects(const Bitboard& other) const {
+  uint64_t any = 0;
+  for (int i = 0; i < kNumWords; ++i) {
+    any |= words_[i] & other.words_[i];
+  }
+  return any != 0;
+}
+
+inline bool Bitboard::Contains(const Bitboard& other) const {
+  uint64_t missing = 0;
+  for (int i = 0; i < kNumWords; ++i) {
+    missing |= other.words_[i] & ~words_[i];
+  }
+  return missing == 0;
+}
+
+inline bool operator==(const Bitboard& lhs, const Bitboard& rhs) {
+  for (int i = 0; i < Bitboard::kNumWords; ++i) {
+    if (lhs.words_[i] != rhs.words_[i]) return false;
+  }
+  return true;
+}
+
+}  // namespace blokus
+
+#endif
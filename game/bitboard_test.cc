@@ -0,0 +1,214 @@
+#include "game/bitboard.h"
+
+#include <utility>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace blokus {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::Pair;
+
+TEST(BitboardTest, Empty) {
+  Bitboard b;
+  EXPECT_TRUE(b.Empty());
+  for (int row = 0; row < Bitboard::kNumRows; ++row) {
+    EXPECT_THAT(b.Row(row), Eq(0));
+  }
+}
+
+TEST(BitboardTest, Full) {
+  Bitboard b = Bitboard::Full();
+  EXPECT_FALSE(b.Empty());
+  for (int row = 0; row < Bitboard::kNumRows; ++row) {
+    EXPECT_THAT(b.Row(row), Eq(Bitboard::kRowMask)) << "row " << row;
+  }
+}
+
+TEST(BitboardTest, SetAndGet) {
+  Bitboard b;
+  b.Set(3, 4);
+  b.Set(19, 19);
+  EXPECT_TRUE(b.Get(3, 4));
+  EXPECT_TRUE(b.Get(19, 19));
+  EXPECT_FALSE(b.Get(4, 3));
+  EXPECT_THAT(b.Row(3), Eq(1u << 4));
+  EXPECT_THAT(b.Row(19), Eq(1u << 19));
+
+  b.Clear(3, 4);
+  EXPECT_FALSE(b.Get(3, 4));
+  b.Clear(19, 19);
+  EXPECT_TRUE(b.Empty());
+}
+
+// Row 3 covers bits 60..79, so it straddles the first two words.
+TEST(BitboardTest, RowStraddlesWords) {
+  Bitboard b = Bitboard::Full();
+  b.ClearRow(3, 0b11111);
+  EXPECT_THAT(b.Row(3), Eq(Bitboard::kRowMask & ~0b11111u));
+  EXPECT_THAT(b.Row(2), Eq(Bitboard::kRowMask));
+  EXPECT_THAT(b.Row(4), Eq(Bitboard::kRowMask));
+
+  b.ClearRow(3, Bitboard::kRowMask);
+  EXPECT_THAT(b.Row(3), Eq(0));
+  for (int col = 0; col < Bitboard::kNumCols; ++col) {
+    EXPECT_FALSE(b.Get(3, col));
+    EXPECT_TRUE(b.Get(2, col));
+    EXPECT_TRUE(b.Get(4, col));
+  }
+}
+
+TEST(BitboardTest, SetRow) {
+  Bitboard b;
+  b.SetRow(3, 0b101);
+  b.SetRow(19, Bitboard::kRowMask);
+  EXPECT_THAT(b.Row(3), Eq(0b101));
+  EXPECT_THAT(b.Row(19), Eq(Bitboard::kRowMask));
+  EXPECT_THAT(b.Row(18), Eq(0));
+  EXPECT_TRUE(b.Get(3, 2));
+  EXPECT_FALSE(b.Get(3, 1));
+}
+
+TEST(BitboardTest, ClearRowIgnoresOverflow) {
+  Bitboard b = Bitboard::Full();
+  b.ClearRow(5, 0b11u << 19);
+  EXPECT_THAT(b.Row(5), Eq(Bitboard::kRowMask & ~(1u << 19)));
+  EXPECT_THAT(b.Row(6), Eq(Bitboard::kRowMask));
+}
+
+TEST(BitboardTest, ForEach) {
+  Bitboard b;
+  b.Set(0, 0);
+  b.Set(3, 5);
+  b.Set(19, 19);
+  std::vector<std::pair<int, int>> cells;
+  b.ForEach([&cells](int row, int col) { cells.emplace_back(row, col); });
+  EXPECT_THAT(cells, ElementsAre(Pair(0, 0), Pair(3, 5), Pair(19, 19)));
+}
+
+TEST(BitboardTest, CountAndSelect) {
+  Bitboard b;
+  EXPECT_THAT(b.Count(), Eq(0));
+  b.Set(0, 0);
+  b.Set(3, 5);
+  b.Set(3, 6);
+  b.Set(19, 19);
+  EXPECT_THAT(b.Count(), Eq(4));
+  EXPECT_THAT(b.Select(0), Eq(Bitboard::Index(0, 0)));
+  EXPECT_THAT(b.Select(1), Eq(Bitboard::Index(3, 5)));
+  EXPECT_THAT(b.Select(2), Eq(Bitboard::Index(3, 6)));
+  EXPECT_THAT(b.Select(3), Eq(Bitboard::Index(19, 19)));
+  EXPECT_THAT(Bitboard::Full().Count(), Eq(Bitboard::kNumBits));
+  EXPECT_THAT(Bitboard::Full().Select(200), Eq(200));
+}
+
+TEST(BitboardTest, ShiftRight) {
+  Bitboard b;
+  b.Set(3, 5);
+  b.Set(19, 19);
+  b.Set(1, 1);
+
+  // Shifting by a cell index moves cells up and to the left.
+  Bitboard shifted = b >> Bitboard::Index(1, 2);
+  Bitboard expected;
+  expected.Set(2, 3);
+  expected.Set(18, 17);
+  // (1, 1) wraps around to the end of row -1, which falls off the board.
+  EXPECT_THAT(shifted, Eq(expected));
+
+  // Shifting across several words.
+  shifted = b >> Bitboard::Index(18, 0);
+  expected = Bitboard();
+  expected.Set(1, 19);
+  EXPECT_THAT(shifted, Eq(expected));
+
+  EXPECT_THAT(b >> 0, Eq(b));
+}
+
+TEST(BitboardTest, ShiftLeft) {
+  Bitboard b;
+  b.Set(0, 0);
+  b.Set(3, 19);
+  b.Set(19, 10);
+
+  // Shifting by a whole row moves every cell down a row.
+  Bitboard shifted = b << Bitboard::Index(1, 0);
+  Bitboard expected;
+  expected.Set(1, 0);
+  expected.Set(4, 19);
+  EXPECT_THAT(shifted, Eq(expected));
+
+  // Cells in the last columns wrap around to the start of the next row.
+  shifted = b << 1;
+  expected = Bitboard();
+  expected.Set(0, 1);
+  expected.Set(4, 0);
+  expected.Set(19, 11);
+  EXPECT_THAT(shifted, Eq(expected));
+
+  // Shifting by more than a word.
+  shifted = b << 70;
+  expected = Bitboard();
+  expected.Set(3, 10);
+  expected.Set(7, 9);
+  EXPECT_THAT(shifted, Eq(expected));
+
+  EXPECT_THAT(b << 0, Eq(b));
+}
+
+TEST(BitboardTest, AndOr) {
+  Bitboard a;
+  a.Set(0, 0);
+  a.Set(10, 10);
+  Bitboard b;
+  b.Set(10, 10);
+  b.Set(19, 0);
+
+  Bitboard both;
+  both.Set(10, 10);
+  EXPECT_THAT(a & b, Eq(both));
+
+  Bitboard either;
+  either.Set(0, 0);
+  either.Set(10, 10);
+  either.Set(19, 0);
+  EXPECT_THAT(a | b, Eq(either));
+
+  EXPECT_TRUE(a.Intersects(b));
+  b.Clear(10, 10);
+  EXPECT_FALSE(a.Intersects(b));
+}
+
+TEST(BitboardTest, Contains) {
+  Bitboard a;
+  a.Set(0, 0);
+  a.Set(10, 10);
+  a.Set(19, 19);
+  Bitboard b;
+  b.Set(10, 10);
+  b.Set(19, 19);
+
+  EXPECT_TRUE(a.Contains(b));
+  EXPECT_FALSE(b.Contains(a));
+  EXPECT_TRUE(a.Contains(Bitboard()));
+  EXPECT_TRUE(Bitboard::Full().Contains(a));
+  b.Set(3, 4);
+  EXPECT_FALSE(a.Contains(b));
+}
+
+TEST(BitboardTest, Complement) {
+  Bitboard b;
+  b.Set(10, 10);
+  Bitboard complement = ~b;
+  EXPECT_FALSE(complement.Get(10, 10));
+  EXPECT_TRUE(complement.Get(10, 11));
+  EXPECT_THAT(~complement, Eq(b));
+  EXPECT_THAT(~Bitboard::Full(), Eq(Bitboard()));
+}
+
+}  // namespace
+}  // namespace blokus
@@ -1,52 +1,154 @@
 #include "game/board.h"
 
-#include <cstring>
+#include <algorithm>
+#include <array>
 
+#include "absl/flags/flag.h"
+#include "absl/log/check.h"
 #include "absl/log/log.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 
+#include "game/zobrist.h"
+
 #define ANSI_COLOR_RESET   "\x1b[0m"
 
+ABSL_FLAG(blokus::MoveGenerator, move_generator,
+          blokus::MoveGenerator::kSlots,
+          "How to find possible moves: slots, bitboard or incremental.");
+
 namespace blokus {
 
 namespace {
 
-// Returns all translated, rotated, and flipped coordinates for the placed
-// tile.
-// TODO(piotrf): consider exposing this as a public api.
-std::vector<Coord> PlacedTile(const Tile& tile, const Placement& placement) {
-  std::vector<Coord> coors = tile.Transform(placement.rotation, placement.flip);
-  for (auto& coor : coors) {
-    coor[0] += placement.coord[0];
-    coor[1] += placement.coord[1];
+// Returns the index of the orientation of the move's tile in the list of all
+// orientations of all tiles.
+int OrientationIndexForMove(const Move& move) {
+  const int index = OrientationIndex(move.tile, move.placement.rotation,
+                                     move.placement.flip);
+  if (index < 0) {
+    LOG(FATAL) << "No orientation found for move: " << move.DebugString();
   }
-  return coors;
+  return index;
 }
 
 const TileOrientation& OrientationForMove(const Move& move) {
-  for (const TileOrientation& o : kTiles[move.tile].orientations()) {
-    if (o.rotation() == move.placement.rotation &&
-        o.flip() == move.placement.flip) {
-      return o;
-    }
-  }
-  LOG(FATAL) << "No orientation found for move: " << move.DebugString();
+  return GetOrientation(OrientationIndexForMove(move));
 }
 
 constexpr int RC(int row, int col) {
   return Board::kNumCols * row + col;
 }
 
-int PlacementHash(const Placement& p) {
-  return RC(p.coord.row(), p.coord.col()) * 8 + p.rotation * 2 + p.flip;
+// A mask with a bit for every tile.
+constexpr uint32_t kAllTiles = (1u << kNumTiles) - 1;
+
+// The number of random placements that SampleMove tries before it lists the
+// moves instead. Positions that need more tries have so few moves that
+// listing them is cheaper.
+constexpr int kMaxSampleTries = 32;
+
+// The most move ids of a single tile: 8 orientations, anywhere on the board.
+constexpr int kMaxTileMoveIds = 8 * RC(Board::kNumRows, 0);
+
+// Returns the positions where the upper-left corner of a tile with the given
+// dimensions can go without the tile hanging off the board.
+const Bitboard& AnchorMask(int num_rows, int num_cols) {
+  static const auto* masks = []() {
+    auto* masks = new Bitboard[6][6];
+    for (int rows = 1; rows <= 5; ++rows) {
+      for (int cols = 1; cols <= 5; ++cols) {
+        for (int r = 0; r + rows <= Board::kNumRows; ++r) {
+          for (int c = 0; c + cols <= Board::kNumCols; ++c) {
+            masks[rows][cols].Set(r, c);
+          }
+        }
+      }
+    }
+    return masks;
+  }();
+  return masks[num_rows][num_cols];
+}
+
+// Returns the positions of the upper-left corner of `orientation` where the
+// tile would cover at least one cell of `cells`.
+Bitboard Overlapping(const TileOrientation& orientation,
+                     const Bitboard& cells) {
+  Bitboard overlapping;
+  for (const Coord& coord : orientation.coords()) {
+    overlapping |= cells >> Bitboard::Index(coord.row(), coord.col());
+  }
+  return overlapping;
+}
+
+// Returns a superset of the positions of the upper-left corner of any tile
+// that would cover at least one cell of `cells`.
+Bitboard Reach(const Bitboard& cells) {
+  Bitboard cols = cells;
+  for (int col = 1; col < 5; ++col) {
+    cols |= cells >> col;
+  }
+  Bitboard reach = cols;
+  for (int row = 1; row < 5; ++row) {
+    reach |= cols >> Bitboard::Index(row, 0);
+  }
+  return reach;
 }
 
-constexpr int kMaxPlacementHash =
-    RC(Board::kNumRows - 1, Board::kNumCols - 1) * 8 + 3 * 2 + 1;
+// Returns the cells that touch a cell of `cells` diagonally. Shifting by a
+// row and a column moves cells in the first or last column around to the
+// other side of the board, so those cells are left out of the matching shifts.
+Bitboard DiagonalNeighbors(const Bitboard& cells) {
+  static const auto* masks = []() {
+    auto* masks = new std::array<Bitboard, 2>;
+    for (int r = 0; r < Board::kNumRows; ++r) {
+      (*masks)[0].SetRow(r, Bitboard::kRowMask & ~1u);
+      (*masks)[1].SetRow(r, Bitboard::kRowMask >> 1);
+    }
+    return masks;
+  }();
+  const Bitboard has_left = cells & (*masks)[0];
+  const Bitboard has_right = cells & (*masks)[1];
+  return (has_left >> RC(1, 1)) | (has_right >> RC(1, -1)) |
+      (has_left << RC(1, -1)) | (has_right << RC(1, 1));
+}
+
+// Returns the xor of the Zobrist keys of `cells`.
+uint64_t CellsHash(Color color, const Bitboard& cells) {
+  const uint64_t* keys = kZobristKeys.cells[color];
+  uint64_t hash = 0;
+  cells.ForEach([&](int row, int col) {
+    hash ^= keys[Bitboard::Index(row, col)];
+  });
+  return hash;
+}
 
 }  // namespace
 
+bool AbslParseFlag(absl::string_view text, MoveGenerator* generator,
+                   std::string* error) {
+  if (text == "slots") {
+    *generator = MoveGenerator::kSlots;
+  } else if (text == "bitboard") {
+    *generator = MoveGenerator::kBitboard;
+  } else if (text == "incremental") {
+    *generator = MoveGenerator::kIncremental;
+  } else {
+    *error = absl::StrCat("unknown move generator: ", text);
+    return false;
+  }
+  return true;
+}
+
+std::string AbslUnparseFlag(MoveGenerator generator) {
+  switch (generator) {
+    case MoveGenerator::kSlots: return "slots";
+    case MoveGenerator::kBitboard: return "bitboard";
+    case MoveGenerator::kIncremental: return "incremental";
+  }
+  return "unknown";
+}
+
 Move Move::EmptyMove(Color color) {
   Move move;
   move.color = color;
@@ -54,6 +156,29 @@ Move Move::EmptyMove(Color color) {
   return move;
 }
 
+MoveId ToMoveId(const Move& move) {
+  if (move.tile == -1) return kPassMoveId;
+  const int index = OrientationIndexForMove(move);
+  const TileOrientation& orientation = GetOrientation(index);
+  return MakeMoveId(
+      index, move.placement.coord.row() - orientation.offset().row(),
+      move.placement.coord.col() - orientation.offset().col());
+}
+
+Move ToMove(MoveId id, Color color) {
+  if (id == kPassMoveId) return Move::EmptyMove(color);
+  const MoveIdInfo& info = GetMoveIdInfo(id);
+  const TileOrientation& orientation = GetOrientation(info.orientation);
+  Move move;
+  move.color = color;
+  move.tile = info.tile;
+  move.placement.coord = Coord(info.row + orientation.offset().row(),
+                               info.col + orientation.offset().col());
+  move.placement.rotation = orientation.rotation();
+  move.placement.flip = orientation.flip();
+  return move;
+}
+
 std::string Move::DebugString() const {
   if (tile == -1) {
     return absl::StrCat(ColorToString(color), " played pass");
@@ -63,195 +188,583 @@ std::string Move::DebugString() const {
   }
 }
 
-Board::Board() {
-  // Initially, there are no pieces on the board.
-  for (int r = 0; r < kNumRows; ++r) {
-    for (int c = 0; c < kNumCols; ++c) {
-      pieces_[r][c] = INVALID;
-    }
+Board::Board() : move_generator_(absl::GetFlag(FLAGS_move_generator)) {
+  // Initially, everyone is allowed to move everywhere.
+  for (auto color : {BLUE, YELLOW, RED, GREEN}) {
+    available_[color] = Bitboard::Full();
   }
 
   // Initially, you can only move in a corner. Place in turn order,
   // going clockwise from top-left (0,0).
-  slots_.resize(5);
-  slot_map_.resize(5);
-  slots_[BLUE].emplace_back(Slot{Coord(0, 0), Slot::SE});
-  slot_map_[BLUE] = std::vector<bool>(kNumRows * kNumCols, false);
-  slot_map_[BLUE][RC(0, 0)] = true;
-  slots_[YELLOW].emplace_back(Slot{Coord(0, kNumCols - 1), Slot::SW});
-  slot_map_[YELLOW] = std::vector<bool>(kNumRows * kNumCols, false);
-  slot_map_[YELLOW][RC(0, kNumCols -1)] = true;
-  slots_[RED].emplace_back(Slot{Coord(kNumRows - 1, kNumCols - 1), Slot::NW});
-  slot_map_[RED] = std::vector<bool>(kNumRows * kNumCols, false);
-  slot_map_[RED][RC(kNumRows - 1, kNumCols - 1)] = true;
-  slots_[GREEN].emplace_back(Slot{Coord(kNumRows - 1, 0), Slot::NE});
-  slot_map_[GREEN] = std::vector<bool>(kNumRows * kNumCols, false);
-  slot_map_[GREEN][RC(kNumRows - 1, 0)] = true;
+  const Slot start_slots[] = {
+      {Coord(0, 0), Slot::SE},
+      {Coord(0, kNumCols - 1), Slot::SW},
+      {Coord(kNumRows - 1, kNumCols - 1), Slot::NW},
+      {Coord(kNumRows - 1, 0), Slot::NE},
+  };
+  for (auto color : {BLUE, YELLOW, RED, GREEN}) {
+    const Slot& slot = start_slots[color - BLUE];
+    num_slots_[color] = 0;
+    frontier_[color].Set(slot.c.row(), slot.c.col());
+    AddSlot(color, slot);
+  }
 
-  // Initially, everyone is allowed to move everywhere.
-  available_.resize(5);
+  // Nothing is legal until the starting slots are scanned in
+  // UpdateLegalMoves.
   for (auto color : {BLUE, YELLOW, RED, GREEN}) {
-    for (int row = 0; row < kNumRows; ++row) {
-      available_[color].push_back(0xFFFFFFFF);
+    tracked_tiles_[color] = (1 << kNumTiles) - 1;
+    first_new_slot_[color] = 0;
+    num_updates_[color] = 0;
+    rebuild_legal_[color] = false;
+    dead_tiles_[color] = 0;
+    for (int tile = 0; tile < kNumTiles; ++tile) {
+      CHECK(FitsAnywhere(kTiles[tile], color, &fits_[color][tile]));
     }
+    UpdateFitsCells(color);
   }
 }
 
-Board::~Board() {
+void Board::AddSlot(Color color, const Slot& slot) {
+  DCHECK(frontier_[color].Get(slot.c.row(), slot.c.col()));
+  CHECK_LT(num_slots_[color], kMaxSlots);
+  slots_[color][num_slots_[color]++] = slot;
+}
+
+void Board::RetireSlots(Color color, const Bitboard& cells, Undo* undo) {
+  int& num_retired = undo->num_retired_slots[color];
+  num_retired = 0;
+  if (!frontier_[color].Intersects(cells)) return;
+
+  Slot* slots = slots_[color];
+  const int first_new_slot = first_new_slot_[color];
+  int num_kept = 0;
+  for (int i = 0; i < num_slots_[color]; ++i) {
+    const Slot& slot = slots[i];
+    if (cells.Get(slot.c.row(), slot.c.col())) {
+      CHECK_LT(num_retired, Undo::kMaxRetiredSlots);
+      undo->retired_slots[color][num_retired] = slot;
+      undo->retired_slot_indices[color][num_retired] = i;
+      ++num_retired;
+      if (i < first_new_slot) --first_new_slot_[color];
+    } else {
+      slots[num_kept++] = slots[i];
+    }
+  }
+  num_slots_[color] = num_kept;
 }
 
 bool Board::IsPossible(const Move& move) const {
   const TileOrientation& orientation = OrientationForMove(move);
+  const int start_row =
+      move.placement.coord.row() - orientation.offset().row();
+  const int start_col =
+      move.placement.coord.col() - orientation.offset().col();
+  if (start_row < 0 || start_row + orientation.num_rows() > kNumRows ||
+      start_col < 0 || start_col + orientation.num_cols() > kNumCols) {
+    return false;
+  }
 
-  // Find a slot that matches one of the corners in the piece.
-  // TODO(piotrf): use a map of slots to speed this up. That also solves the
-  // slot duplication issue.
-  for (const Corner& corner : orientation.corners()) {
-    const int r = move.placement.coord.row() + corner.c.row()
-        - orientation.offset().row();
-    const int c = move.placement.coord.col() + corner.c.col()
-        - orientation.offset().col();
-    for (const SlotInfo& slot_info : slots_[move.color]) {
-      if (slot_info.slot.c.row() != r || slot_info.slot.c.col() != c) continue;
-      return IsPossible(slot_info.slot, orientation, corner, move.color);
+  // The tile has to fit, and cover one of the slots.
+  const Bitboard& footprint = Footprint(ToMoveId(move));
+  return available_[move.color].Contains(footprint) &&
+      footprint.Intersects(frontier_[move.color]);
+}
+
+std::vector<Move> Board::PossibleMoves(const Tile& tile, Color color) const {
+  MoveList ids;
+  ids.Grow(GenerateMoves(tile, color, ids.unused()));
+  std::vector<Move> moves;
+  moves.reserve(ids.size());
+  for (MoveId id : ids) {
+    moves.push_back(ToMove(id, color));
+  }
+  return moves;
+}
+
+int Board::GenerateMoves(const Tile& tile, Color color,
+                         absl::Span<MoveId> moves) const {
+  const uint32_t tile_bit = 1u << tile.index();
+  if (dead_tiles_[color] & tile_bit) return 0;
+
+  int num_moves = 0;
+  switch (move_generator_) {
+    case MoveGenerator::kSlots:
+      num_moves = SlotGenerateMoves(tile, color, moves);
+      break;
+    case MoveGenerator::kBitboard:
+      num_moves = BitboardGenerateMoves(tile, color, moves);
+      break;
+    case MoveGenerator::kIncremental: {
+      if (!LegalMovesCurrent(color) || !(tracked_tiles_[color] & tile_bit)) {
+        // Fall back to finding moves from scratch if legal_moves_ is missing
+        // or out of date, or if the tile has been placed and is no longer
+        // tracked.
+        num_moves = BitboardGenerateMoves(tile, color, moves);
+        break;
+      }
+      const int first = FirstOrientation(tile.index());
+      for (size_t i = 0; i < tile.orientations().size(); ++i) {
+        legal_moves_->anchors[color][first + i].ForEach([&](int row, int col) {
+          DCHECK_LT(num_moves, moves.size());
+          moves[num_moves++] = MakeMoveId(first + i, row, col);
+        });
+      }
+      break;
     }
   }
 
-  return false;
+  return num_moves;
 }
 
-bool Board::IsPossible(const Slot& slot,
-                       const TileOrientation& orientation,
-                       const Corner& corner, Color color) const {
-  if (!CornerFitsSlot(corner, slot)) return false;
+int Board::CountMoves(const Tile& tile, Color color) const {
+  const uint32_t tile_bit = 1u << tile.index();
+  if (dead_tiles_[color] & tile_bit) return 0;
 
-  // Compute the coordinates of the upper-left corner.
-  const int start_row = slot.c.row() - corner.c.row();
-  const int start_col = slot.c.col() - corner.c.col();
+  int num_moves = 0;
+  if (move_generator_ == MoveGenerator::kSlots) {
+    // The slots generator only knows how many moves there are after
+    // deduplicating them.
+    MoveId moves[kMaxTileMoveIds];
+    num_moves = SlotGenerateMoves(tile, color, absl::MakeSpan(moves));
+  } else {
+    for (size_t i = 0; i < tile.orientations().size(); ++i) {
+      num_moves += LegalAnchors(tile, i, color).Count();
+    }
+  }
+  return num_moves;
+}
 
-  // See if the whole block fits, based on the width and height.
-  if (start_row < 0 || start_row + orientation.num_rows() > kNumRows)
-    return false;
-  if (start_col < 0 || start_col + orientation.num_cols() > kNumCols)
-    return false;
+MoveId Board::NthMove(const Tile& tile, Color color, int n) const {
+  if (move_generator_ == MoveGenerator::kSlots) {
+    MoveId moves[kMaxTileMoveIds];
+    SlotGenerateMoves(tile, color, absl::MakeSpan(moves));
+    return moves[n];
+  }
+  const int first = FirstOrientation(tile.index());
+  for (size_t i = 0; i < tile.orientations().size(); ++i) {
+    const Bitboard anchors = LegalAnchors(tile, i, color);
+    const int count = anchors.Count();
+    if (n < count) {
+      const int anchor = anchors.Select(n);
+      return MakeMoveId(first + i, anchor / kNumCols, anchor % kNumCols);
+    }
+    n -= count;
+  }
+  LOG(FATAL) << "Tile " << tile.index() << " has fewer moves than asked for";
+}
 
-  // Now test the block against available free space on the board.
-  for (int block_row = 0; block_row < orientation.num_rows(); ++block_row) {
-    const int board_row = block_row + start_row;
-    const uint32_t slice = (orientation.rows()[block_row]) << start_col;
-    const uint32_t board_slice = available_[color][board_row];
-    if ((slice | board_slice) != board_slice) {
-      return false;
+MoveId Board::SampleMove(Color color, Rng* rng) const {
+  // Every legal move is found on each slot it covers, and covers it with a
+  // corner, see SlotGenerateMoves. So picking one of the placements with a
+  // corner on a slot uniformly at random, and keeping it if it is legal with
+  // one over the number of slots it covers as the probability, gives every
+  // legal move the same chance. Counting the placements on the slots only
+  // takes table lookups.
+  const uint32_t tiles = kAllTiles & ~dead_tiles_[color];
+  const Slot* slots = slots_[color];
+  int num_placements[kMaxSlots];
+  int total = 0;
+  for (int i = 0; i < num_slots_[color]; ++i) {
+    const Slot& slot = slots[i];
+    num_placements[i] = 0;
+    for (uint32_t t = tiles; t; t &= t - 1) {
+      num_placements[i] +=
+          CornerPlacements(__builtin_ctz(t), slot.c.row(), slot.c.col())
+              .size();
     }
+    total += num_placements[i];
+  }
+  if (total == 0) return kPassMoveId;
+
+  const Bitboard& available = available_[color];
+  for (int tries = 0; tries < kMaxSampleTries; ++tries) {
+    int n = rng->Uniform(total);
+    int i = 0;
+    while (n >= num_placements[i]) {
+      n -= num_placements[i++];
+    }
+    const Slot& slot = slots[i];
+    absl::Span<const CornerPlacement> placements;
+    for (uint32_t t = tiles;; t &= t - 1) {
+      placements =
+          CornerPlacements(__builtin_ctz(t), slot.c.row(), slot.c.col());
+      const int size = placements.size();
+      if (n < size) break;
+      n -= size;
+    }
+    const CornerPlacement& placement = placements[n];
+    const Bitboard& footprint = Footprint(placement.id);
+    if (!CornerFitsSlot(placement.type, slot.type) ||
+        !available.Contains(footprint)) {
+      continue;
+    }
+    const int num_slots = (footprint & frontier_[color]).Count();
+    if (num_slots == 1 || rng->Uniform(num_slots) == 0) return placement.id;
   }
 
-  return true;
+  // Every try so far was equally likely to pick each move, so falling back to
+  // listing them keeps the choice uniform.
+  MoveList moves;
+  for (uint32_t t = tiles; t; t &= t - 1) {
+    moves.Grow(GenerateMoves(kTiles[__builtin_ctz(t)], color, moves.unused()));
+  }
+  if (moves.empty()) return kPassMoveId;
+  return moves[rng->Uniform(moves.size())];
 }
 
-// Returns a list of all possible moves for the given tile and color.
-std::vector<Move> Board::PossibleMoves(const Tile& tile, Color color) const {
-  std::vector<Move> moves;
-  moves.reserve(200);
+bool Board::HasMoves(Color color) const {
+  const uint32_t tiles = kAllTiles & ~dead_tiles_[color];
+  // The placement that keeps a tile alive fits, so it is a move if it also
+  // covers a cell of the frontier. This usually settles it.
+  for (uint32_t t = tiles; t; t &= t - 1) {
+    if (Footprint(fits_[color][__builtin_ctz(t)])
+            .Intersects(frontier_[color])) {
+      return true;
+    }
+  }
 
-  // Prevent duplicate moves that can occur when different corner/slot combos
-  // result in the same exact placement.
-  bool placement_hashes[kMaxPlacementHash];
-  std::memset(placement_hashes, 0, sizeof placement_hashes);
-
-  Move move_template;
-  move_template.tile = tile.index();
-  move_template.color = color;
-
-  for (const SlotInfo& slot_info : slots_[color]) {
-    if (!slot_info.IsAvailable(tile)) continue;
-    const Slot& slot = slot_info.slot;
-
-    bool is_possible = false;
-    for (const TileOrientation& orientation : tile.orientations()) {
-      for (const Corner& corner : orientation.corners()) {
-        if (IsPossible(slot, orientation, corner, color)) {
-          is_possible = true;
-
-          Move move = move_template;
-          move.placement.coord =
-              Coord(slot.c[0] + orientation.offset()[0] - corner.c[0],
-                    slot.c[1] + orientation.offset()[1] - corner.c[1]);
-          move.placement.rotation = orientation.rotation();
-          move.placement.flip = orientation.flip();
-
-          const int hash = PlacementHash(move.placement);
-          if (placement_hashes[hash] == false) {
-            placement_hashes[hash] = true;
-            moves.push_back(std::move(move));
-          }
+  const Bitboard& available = available_[color];
+  for (int i = 0; i < num_slots_[color]; ++i) {
+    const Slot& slot = slots_[color][i];
+    for (uint32_t t = tiles; t; t &= t - 1) {
+      const absl::Span<const CornerPlacement> placements =
+          CornerPlacements(__builtin_ctz(t), slot.c.row(), slot.c.col());
+      for (uint64_t fits = FittingPlacements(available, placements); fits;
+           fits &= fits - 1) {
+        if (CornerFitsSlot(placements[__builtin_ctzll(fits)].type, slot.type)) {
+          return true;
         }
       }
     }
+  }
+  return false;
+}
+
+Bitboard Board::LegalAnchors(const Tile& tile, int i, Color color) const {
+  if (move_generator_ == MoveGenerator::kIncremental &&
+      LegalMovesCurrent(color) &&
+      (tracked_tiles_[color] & (1u << tile.index()))) {
+    return legal_moves_->anchors[color][FirstOrientation(tile.index()) + i];
+  }
+  return Anchors(tile.orientations()[i], color, frontier_[color]);
+}
+
+bool Board::FitsAnywhere(const Tile& tile, Color color, MoveId* fit) const {
+  const Bitboard& available = available_[color];
+  const int first = FirstOrientation(tile.index());
+  for (size_t i = 0; i < tile.orientations().size(); ++i) {
+    const TileOrientation& orientation = tile.orientations()[i];
+    Bitboard anchors =
+        AnchorMask(orientation.num_rows(), orientation.num_cols());
+    for (const Coord& coord : orientation.coords()) {
+      anchors &= available >> Bitboard::Index(coord.row(), coord.col());
+    }
+    if (!anchors.Empty()) {
+      const int anchor = anchors.Select(anchors.Count() / 2);
+      *fit = MakeMoveId(first + i, anchor / kNumCols, anchor % kNumCols);
+      return true;
+    }
+  }
+  return false;
+}
 
-    if (!is_possible) {
-      slot_info.SetUnavailable(tile);
+void Board::UpdateDeadTiles(Color color, const Bitboard& cells) {
+  // Most moves are far from the placements that were known to fit.
+  if (!fits_cells_[color].Intersects(cells)) return;
+  for (int tile = 0; tile < kNumTiles; ++tile) {
+    if (dead_tiles_[color] & (1u << tile)) continue;
+    if (!Footprint(fits_[color][tile]).Intersects(cells)) continue;
+    if (!FitsAnywhere(kTiles[tile], color, &fits_[color][tile])) {
+      dead_tiles_[color] |= 1u << tile;
     }
   }
+  UpdateFitsCells(color);
+}
 
-  return moves;
+void Board::UpdateFitsCells(Color color) {
+  Bitboard cells;
+  for (int tile = 0; tile < kNumTiles; ++tile) {
+    if (dead_tiles_[color] & (1u << tile)) continue;
+    cells |= Footprint(fits_[color][tile]);
+  }
+  fits_cells_[color] = cells;
+}
+
+int Board::SlotGenerateMoves(const Tile& tile, Color color,
+                             absl::Span<MoveId> moves) const {
+  // Prevent duplicate moves that can occur when different corner/slot combos
+  // result in the same exact placement. Moves of the tile have ids from
+  // `first_id` on.
+  const int first = FirstOrientation(tile.index());
+  const int first_id = MakeMoveId(first, 0, 0);
+  uint64_t seen[kMaxTileMoveIds / 64] = {};
+
+  const Bitboard& available = available_[color];
+  int num_moves = 0;
+  for (int i = 0; i < num_slots_[color]; ++i) {
+    const Slot& slot = slots_[color][i];
+
+    // Test every placement on the slot's cell at once, and then check the
+    // corners of those that fit.
+    const absl::Span<const CornerPlacement> placements =
+        CornerPlacements(tile.index(), slot.c.row(), slot.c.col());
+    for (uint64_t fits = FittingPlacements(available, placements); fits;
+         fits &= fits - 1) {
+      const CornerPlacement& placement = placements[__builtin_ctzll(fits)];
+      if (!CornerFitsSlot(placement.type, slot.type)) continue;
+
+      const int bit = placement.id - first_id;
+      if (!(seen[bit / 64] & (uint64_t{1} << (bit % 64)))) {
+        seen[bit / 64] |= uint64_t{1} << (bit % 64);
+        DCHECK_LT(num_moves, moves.size());
+        moves[num_moves++] = placement.id;
+      }
+    }
+  }
+
+  return num_moves;
+}
+
+int Board::BitboardGenerateMoves(const Tile& tile, Color color,
+                                 absl::Span<MoveId> moves) const {
+  // A new tile must cover at least one cell of the frontier.
+  const Bitboard& slots = frontier_[color];
+
+  int num_moves = 0;
+  const int first = FirstOrientation(tile.index());
+  for (size_t i = 0; i < tile.orientations().size(); ++i) {
+    const Bitboard anchors = Anchors(tile.orientations()[i], color, slots);
+    anchors.ForEach([&](int row, int col) {
+      DCHECK_LT(num_moves, moves.size());
+      moves[num_moves++] = MakeMoveId(first + i, row, col);
+    });
+  }
+
+  return num_moves;
+}
+
+Bitboard Board::Anchors(const TileOrientation& orientation, Color color,
+                         const Bitboard& slots) const {
+  // Only corners of a tile can touch a slot in a valid placement.
+  Bitboard anchors;
+  for (const Corner& corner : orientation.corners()) {
+    anchors |= slots >> Bitboard::Index(corner.c.row(), corner.c.col());
+  }
+  if (anchors.Empty()) return anchors;
+
+  // A bit in `anchors` represents placing the upper-left corner of the
+  // orientation at that cell. Shifting a bitboard by a block's position
+  // lines up that block with the anchor, so after AND-ing in every block
+  // only the anchors where the whole tile is available remain.
+  anchors &= AnchorMask(orientation.num_rows(), orientation.num_cols());
+  const Bitboard& available = available_[color];
+  for (const Coord& coord : orientation.coords()) {
+    anchors &= available >> Bitboard::Index(coord.row(), coord.col());
+  }
+  return anchors;
+}
+
+void Board::AttachLegalMoves(LegalMoves* legal_moves) {
+  CHECK(move_generator_ == MoveGenerator::kIncremental);
+  legal_moves_ = legal_moves;
+  legal_moves_->board = this;
+  // Whatever is in `legal_moves` belongs to some other board.
+  for (auto color : {BLUE, YELLOW, RED, GREEN}) {
+    rebuild_legal_[color] = true;
+  }
+}
+
+void Board::UpdateLegalMoves(Color color) {
+  if (move_generator_ != MoveGenerator::kIncremental) return;
+  if (!OwnsLegalMoves() || LegalMovesCurrent(color)) return;
+  ++num_updates_[color];
+
+  if (rebuild_legal_[color]) {
+    const Bitboard& slots = frontier_[color];
+    for (int tile = 0; tile < kNumTiles; ++tile) {
+      if (!(tracked_tiles_[color] & (1 << tile))) continue;
+      Bitboard* legal = &legal_moves_->anchors[color][FirstOrientation(tile)];
+      for (const TileOrientation& orientation : kTiles[tile].orientations()) {
+        *(legal++) = Anchors(orientation, color, slots);
+      }
+    }
+    stale_cells_[color] = Bitboard();
+    first_new_slot_[color] = num_slots_[color];
+    rebuild_legal_[color] = false;
+    return;
+  }
+
+  // Moves only take away placements that overlap the cells which became
+  // unavailable. Most orientations have no placements near those cells, which
+  // is cheap to check before computing the exact overlap.
+  const Bitboard& cells = stale_cells_[color];
+  if (!cells.Empty()) {
+    const Bitboard reach = Reach(cells);
+    for (int tile = 0; tile < kNumTiles; ++tile) {
+      if (!(tracked_tiles_[color] & (1 << tile))) continue;
+      Bitboard* legal = &legal_moves_->anchors[color][FirstOrientation(tile)];
+      for (const TileOrientation& orientation : kTiles[tile].orientations()) {
+        if (legal->Intersects(reach)) {
+          *legal &= ~Overlapping(orientation, cells);
+        }
+        ++legal;
+      }
+    }
+    stale_cells_[color] = Bitboard();
+  }
+
+  // The only new placements are the ones touching the new slots, since
+  // availability only shrinks.
+  Bitboard new_slots;
+  for (int i = first_new_slot_[color]; i < num_slots_[color]; ++i) {
+    const Slot& slot = slots_[color][i];
+    new_slots.Set(slot.c.row(), slot.c.col());
+  }
+  if (!new_slots.Empty()) {
+    for (int tile = 0; tile < kNumTiles; ++tile) {
+      if (!(tracked_tiles_[color] & (1 << tile))) continue;
+      Bitboard* legal = &legal_moves_->anchors[color][FirstOrientation(tile)];
+      for (const TileOrientation& orientation : kTiles[tile].orientations()) {
+        *(legal++) |= Anchors(orientation, color, new_slots);
+      }
+    }
+  }
+  first_new_slot_[color] = num_slots_[color];
 }
 
 bool Board::MakeMove(const Move& move) {
+  Undo undo;
+  return MakeMove(move, &undo);
+}
+
+bool Board::MakeMove(const Move& move, Undo* undo) {
   if (!IsPossible(move)) {
     return false;
   }
-  std::vector<Coord> coords = PlacedTile(kTiles[move.tile], move.placement);
-  for (const Coord& coord : coords) {
-    pieces_[coord.row()][coord.col()] = move.color;
-  }
 
-  // Update slots based on the move.
+  // Save the state that the move is about to change. Only the rows of the
+  // tile, plus one on either side, are touched.
   const TileOrientation& orientation = OrientationForMove(move);
+  undo->first_row = std::max(
+      0, move.placement.coord.row() - orientation.offset().row() - 1);
+  undo->num_rows = std::min(
+      kNumRows, move.placement.coord.row() - orientation.offset().row() +
+                    orientation.num_rows() + 1) - undo->first_row;
+  for (auto color : {BLUE, YELLOW, RED, GREEN}) {
+    for (int i = 0; i < undo->num_rows; ++i) {
+      undo->available[color][i] = available_[color].Row(undo->first_row + i);
+      undo->stale_cells[color][i] =
+          stale_cells_[color].Row(undo->first_row + i);
+      undo->frontier[color][i] = frontier_[color].Row(undo->first_row + i);
+    }
+    undo->num_updates[color] = num_updates_[color];
+    undo->first_new_slot[color] = first_new_slot_[color];
+    undo->dead_tiles[color] = dead_tiles_[color];
+  }
+
+  // Update available bitmap based on the move. The other colors only lose
+  // the cells of the tile, while the move color also loses the cells next to
+  // it. Frontier cells and slots on those cells can't take any tile anymore,
+  // so they are retired right away.
+  const MoveId id = ToMoveId(move);
+  const Bitboard& placed = Footprint(id);
+  const Bitboard blocked = placed | Halo(id);
+  pieces_[move.color] |= placed;
+  hash_ ^= CellsHash(move.color, placed);
+  const Bitboard not_placed = ~placed;
+  for (auto color : {BLUE, YELLOW, RED, GREEN}) {
+    const bool is_move_color = color == move.color;
+    available_[color] &= is_move_color ? ~blocked : not_placed;
+    RetireSlots(color, is_move_color ? blocked : placed, undo);
+    frontier_[color] &= available_[color];
+    if (is_move_color) dead_tiles_[color] |= 1u << move.tile;
+    UpdateDeadTiles(color, is_move_color ? blocked : placed);
+  }
+  undo->num_slots = num_slots_[move.color];
+
+  // The move color's frontier gains the available cells diagonal to the tile.
+  // Each new frontier cell gets the slot of the tile that faces it.
+  Bitboard new_corners = DiagonalNeighbors(placed) & available_[move.color] &
+      ~frontier_[move.color];
+  frontier_[move.color] |= new_corners;
   for (Slot slot : orientation.slots()) {
     slot.c[0] += move.placement.coord[0] - orientation.offset()[0];
     slot.c[1] += move.placement.coord[1] - orientation.offset()[1];
     if (slot.c.row() < 0 || slot.c.row() >= kNumRows ||
-        slot.c.col() < 0 || slot.c.col() >= kNumCols) {
+        slot.c.col() < 0 || slot.c.col() >= kNumCols ||
+        !new_corners.Get(slot.c.row(), slot.c.col())) {
       continue;
     }
-    const int rc = RC(slot.c.row(), slot.c.col());
-    if (!slot_map_[move.color][rc]) {
-      slots_[move.color].emplace_back(slot);
-      slot_map_[move.color][rc] = true;
+    new_corners.Clear(slot.c.row(), slot.c.col());
+    AddSlot(move.color, slot);
+  }
+  DCHECK(new_corners.Empty());
+
+  if (move_generator_ == MoveGenerator::kIncremental) {
+    tracked_tiles_[move.color] &= ~(1 << move.tile);
+    for (auto color : {BLUE, YELLOW, RED, GREEN}) {
+      stale_cells_[color] |= color == move.color ? blocked : placed;
     }
   }
 
-  // Update available bitmap based on the move.
-  // First, update the non-move colors. Only the blocks in the tile
-  // are marked unavailable.
-  const int start_row =
-      move.placement.coord.row() - orientation.offset().row();
-  const int start_col =
-      move.placement.coord.col() - orientation.offset().col();
+  return true;
+}
+
+void Board::UnmakeMove(const Move& move, const Undo& undo) {
+  const Bitboard& placed = Footprint(ToMoveId(move));
+  pieces_[move.color] &= ~placed;
+  hash_ ^= CellsHash(move.color, placed);
+
   for (auto color : {BLUE, YELLOW, RED, GREEN}) {
-    if (color == move.color) continue;
-    for (int block_row = 0; block_row < orientation.num_rows(); ++block_row) {
-      const int board_row = start_row + block_row;
-      const uint32_t slice = (orientation.rows()[block_row]) << start_col;
-      available_[color][board_row] &= ~slice;
+    for (int i = 0; i < undo.num_rows; ++i) {
+      const int row = undo.first_row + i;
+      available_[color].ClearRow(row, Bitboard::kRowMask);
+      available_[color].SetRow(row, undo.available[color][i]);
+      stale_cells_[color].ClearRow(row, Bitboard::kRowMask);
+      stale_cells_[color].SetRow(row, undo.stale_cells[color][i]);
+      frontier_[color].ClearRow(row, Bitboard::kRowMask);
+      frontier_[color].SetRow(row, undo.frontier[color][i]);
     }
   }
-  // Next, update the move color. The blocks in the tile and all surrounding
-  // blocks are marked unavailable.
-  for (int block_row = 0; block_row < orientation.num_rows() + 2;
-       ++block_row) {
-    const int board_row = start_row + block_row - 1;
-    if (board_row < 0 || board_row >= kNumRows) continue;
-    uint32_t slice;
-    if (start_col == 0) {
-      slice = (orientation.expanded_rows()[block_row]) >> 1;
-    } else {
-      slice = (orientation.expanded_rows()[block_row]) << (start_col - 1);
+
+  num_slots_[move.color] = undo.num_slots;
+
+  // Put the retired slots back where they were.
+  for (auto color : {BLUE, YELLOW, RED, GREEN}) {
+    Slot* slots = slots_[color];
+    for (int i = 0; i < undo.num_retired_slots[color]; ++i) {
+      const int index = undo.retired_slot_indices[color][i];
+      std::copy_backward(slots + index, slots + num_slots_[color],
+                         slots + num_slots_[color] + 1);
+      slots[index] = undo.retired_slots[color][i];
+      ++num_slots_[color];
+    }
+    first_new_slot_[color] = undo.first_new_slot[color];
+    // Tiles found to be dead after the move may fit again, with the
+    // placements that they last fit in.
+    if (dead_tiles_[color] != undo.dead_tiles[color]) {
+      dead_tiles_[color] = undo.dead_tiles[color];
+      UpdateFitsCells(color);
     }
-    available_[move.color][board_row] &= ~slice;
   }
 
-  return true;
+  if (move_generator_ == MoveGenerator::kIncremental) {
+    // If a color's legal moves were updated after the move was made, they
+    // can't be patched back and have to be rebuilt.
+    tracked_tiles_[move.color] |= 1 << move.tile;
+    for (auto color : {BLUE, YELLOW, RED, GREEN}) {
+      if (num_updates_[color] != undo.num_updates[color]) {
+        rebuild_legal_[color] = true;
+      }
+    }
+  }
+}
+
+Color Board::PieceAt(int row, int col) const {
+  for (auto color : {BLUE, YELLOW, RED, GREEN}) {
+    if (pieces_[color].Get(row, col)) return color;
+  }
+  return INVALID;
 }
 
 void Board::Print(bool debug) const {
@@ -264,8 +777,9 @@ void Board::Print(bool debug) const {
   for (int r = 0; r < kNumRows; ++r) {
     printf("%2d ", r);
     for (int c = 0; c < kNumCols; ++c) {
-      if (pieces_[r][c]) {
-        std::string out = AnsiColor(pieces_[r][c]) + "\u25a3";
+      const Color piece = PieceAt(r, c);
+      if (piece != INVALID) {
+        std::string out = AnsiColor(piece) + "\u25a3";
         printf(" %s" ANSI_COLOR_RESET " ", out.c_str());
       } else {
         printf(" _ ");
@@ -3,13 +3,42 @@
 
 #include <map>
 #include <string>
+#include <type_traits>
 #include <vector>
 
+#include "absl/flags/declare.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+
+#include "game/bitboard.h"
 #include "game/defs.h"
+#include "game/move_id.h"
+#include "game/rng.h"
 #include "game/tile.h"
 
 namespace blokus {
 
+// Algorithms that Board can use to find possible moves.
+enum class MoveGenerator {
+  // Test every orientation and corner of a tile against every slot.
+  kSlots,
+  // Find all placements of an orientation at once with bitboard shifts.
+  kBitboard,
+  // Keep the legal placements of every tile up to date as moves are made.
+  kIncremental,
+};
+
+bool AbslParseFlag(absl::string_view text, MoveGenerator* generator,
+                   std::string* error);
+std::string AbslUnparseFlag(MoveGenerator generator);
+
+}  // namespace blokus
+
+// The move generator used by newly constructed boards.
+ABSL_DECLARE_FLAG(blokus::MoveGenerator, move_generator);
+
+namespace blokus {
+
 // Move fully represents a single move in the game.
 struct Move {
   static Move EmptyMove(Color color);
@@ -20,13 +49,30 @@ struct Move {
   Placement placement;    // How the tile was played.
 };
 
+// Converts between moves and their ids, see move_id.h.
+MoveId ToMoveId(const Move& move);
+Move ToMove(MoveId id, Color color);
+
+class Board;
+
+// For the incremental generator: the legal positions of the upper-left corner
+// of every orientation of every tile, indexed by color and then by the
+// orientation's position in the list of all orientations of all tiles. This is
+// several times bigger than the rest of the board, so it lives outside of it
+// and only whoever runs the incremental generator allocates one, see
+// Board::AttachLegalMoves.
+struct LegalMoves {
+  Bitboard anchors[5][kNumOrientations];
+  // The board that keeps these up to date. Copies of it don't use them.
+  const Board* board = nullptr;
+};
+
 class Board {
  public:
-  static const int kNumRows = 20;
-  static const int kNumCols = 20;
+  static constexpr int kNumRows = 20;
+  static constexpr int kNumCols = 20;
   
   Board();
-  ~Board();
 
   // Returns true if the given move respects the geometry of the board and rules
   // of the game. Note that Board does not track the current player or the
@@ -35,57 +81,222 @@ class Board {
   bool IsPossible(const Move& move) const;
 
   // Returns a list of all possible moves for the given tile and color.
+  // The order of the moves depends on the move generator.
   std::vector<Move> PossibleMoves(const Tile& tile, Color color) const;
 
+  // Like the above, but writes the ids of the moves to `moves` and returns
+  // how many there are, without allocating. `moves` must have room for all of
+  // them.
+  int GenerateMoves(const Tile& tile, Color color,
+                    absl::Span<MoveId> moves) const;
+
+  // Returns the number of moves that GenerateMoves would find. This is a
+  // popcount per orientation, except with the slots generator, which has to
+  // find the moves to count them, see CountsMovesCheaply.
+  int CountMoves(const Tile& tile, Color color) const;
+
+  // Returns true if CountMoves is much cheaper than GenerateMoves.
+  bool CountsMovesCheaply() const {
+    return move_generator_ != MoveGenerator::kSlots;
+  }
+
+  // Returns the `n`th move of `tile` for `color`, with n < CountMoves. The
+  // order is fixed for a position, but may differ from GenerateMoves.
+  MoveId NthMove(const Tile& tile, Color color, int n) const;
+
+  // Returns one of the moves of `color`, chosen uniformly at random with
+  // `rng`, or kPassMoveId if there are none. This tries random placements on
+  // the color's slots until one is legal, so unlike CountMoves it doesn't
+  // have to find every move with the slots generator.
+  MoveId SampleMove(Color color, Rng* rng) const;
+
+  // Returns true if `color` has any move, stopping at the first one found.
+  bool HasMoves(Color color) const;
+
+  // Returns a mask of the tiles that `color` can't place anywhere on the
+  // board anymore, no matter where its future slots are. Since availability
+  // only shrinks, a dead tile stays dead for the rest of the game, and
+  // GenerateMoves returns right away for it. Tiles that the color has
+  // already played count as dead too.
+  uint32_t dead_tiles(Color color) const { return dead_tiles_[color]; }
+
+  // Everything needed to take back a move, filled in by MakeMove.
+  // This holds the rows of the board around the move as they were before it.
+  struct Undo {
+    static const int kMaxRows = 7;
+    // The most slots a color can lose in one move: one on every cell of a
+    // tile and the cells next to it.
+    static const int kMaxRetiredSlots = 17;
+
+    int first_row;
+    int num_rows;
+    uint32_t available[5][kMaxRows];
+    uint32_t stale_cells[5][kMaxRows];
+    uint32_t frontier[5][kMaxRows];
+    // The number of slots the moving color had before adding new ones.
+    int num_slots;
+    // The slots each color lost, with their indices in the slot list before
+    // the move, in increasing order.
+    int num_retired_slots[5];
+    Slot retired_slots[5][kMaxRetiredSlots];
+    uint8_t retired_slot_indices[5][kMaxRetiredSlots];
+    // The first slot of each color that was new since its last update.
+    int first_new_slot[5];
+    // The number of legal move updates each color had.
+    uint32_t num_updates[5];
+    uint32_t dead_tiles[5];
+  };
+
   // Place a tile on the board. Returns true if the move was valid.
   // An invalid move will not change the state of the board.
   bool MakeMove(const Move& move);
 
+  // Like the above, but also fills in `undo` so that the move can be taken
+  // back with UnmakeMove.
+  bool MakeMove(const Move& move, Undo* undo);
+
+  // Takes back `move`, which must be the last move made on this board, using
+  // the `undo` that MakeMove filled in for it.
+  void UnmakeMove(const Move& move, const Undo& undo);
+
+  // With the incremental move generator, brings the legal moves of `color` up
+  // to date with the moves made since the last update. Only the placements
+  // near those moves are revisited. PossibleMoves still works for a color that
+  // is out of date, but has to find its moves from scratch.
+  void UpdateLegalMoves(Color color);
+
+  // With the incremental move generator, makes this board keep its legal
+  // moves in `legal_moves`, which must outlive it. Any board that used
+  // `legal_moves` before stops using it. Until a board has legal moves
+  // attached, it finds its moves from scratch like the bitboard generator.
+  void AttachLegalMoves(LegalMoves* legal_moves);
+
+  MoveGenerator move_generator() const { return move_generator_; }
+
+  // Returns the color of the piece at the given position, or INVALID if the
+  // position is empty.
+  Color PieceAt(int row, int col) const;
+
+  // Returns the cells where `color` can attach a new tile: the cells diagonal
+  // to its pieces that are still available to it, or its starting corner
+  // before its first move. Every legal move covers one of them.
+  const Bitboard& frontier(Color color) const { return frontier_[color]; }
+
+  // Returns the Zobrist hash of the pieces on the board, see zobrist.h.
+  uint64_t hash() const { return hash_; }
+
   // Print the board to stdout, with terminal colors.
   // TODO(piotrf): return a string instead.
   void Print(bool debug = false) const;
   
  private:
-  bool IsPossible(const Slot& slot,
-                  const TileOrientation& orientation,
-                  const Corner& corner, Color color) const;
-  
-  Color pieces_[kNumRows][kNumCols];
+  // Finds moves by testing the placements of the tile that have a corner on
+  // each slot of the color, see CornerPlacements.
+  int SlotGenerateMoves(const Tile& tile, Color color,
+                        absl::Span<MoveId> moves) const;
+
+  // Finds moves by computing, for each orientation, the bitboard of all
+  // positions where the tile fits and touches a slot. Each move is found
+  // exactly once, so no deduplication is needed.
+  int BitboardGenerateMoves(const Tile& tile, Color color,
+                            absl::Span<MoveId> moves) const;
+
+  // Returns the positions of the upper-left corner of `orientation` where it
+  // fits on the board for `color` and covers at least one cell of `slots`.
+  Bitboard Anchors(const TileOrientation& orientation, Color color,
+                   const Bitboard& slots) const;
+
+  // Returns the positions of the upper-left corner of the `i`th orientation of
+  // `tile` where it is a legal move for `color`. This uses legal_moves_ when it
+  // is up to date, and Anchors otherwise.
+  Bitboard LegalAnchors(const Tile& tile, int i, Color color) const;
+
+  // Returns true if some placement of `tile` fits on the cells available to
+  // `color`, whether or not it touches a slot, and sets `fit` to one of them.
+  bool FitsAnywhere(const Tile& tile, Color color, MoveId* fit) const;
+
+  // Updates dead_tiles_ for `color`, which just lost `cells`.
+  void UpdateDeadTiles(Color color, const Bitboard& cells);
+
+  // Recomputes fits_cells_ for `color`.
+  void UpdateFitsCells(Color color);
 
-  // Bitwise representation of the rows in the board, one for each color.
-  // Column 0 corresponds to the least significant bit in each uint32_t.
+  // Returns true if legal_moves_ belongs to this board, rather than to the
+  // board it was copied from.
+  bool OwnsLegalMoves() const {
+    return legal_moves_ != nullptr && legal_moves_->board == this;
+  }
+
+  // Returns true if legal_moves_ is up to date for `color`.
+  bool LegalMovesCurrent(Color color) const {
+    return OwnsLegalMoves() && !rebuild_legal_[color] &&
+        stale_cells_[color].Empty() &&
+        first_new_slot_[color] == num_slots_[color];
+  }
+
+  // Adds a slot for the given color. The slot's cell must be on the frontier
+  // and not have a slot yet.
+  void AddSlot(Color color, const Slot& slot);
+
+  // Removes the slots of `color` on `cells`, which the color can't play on
+  // anymore, and records them in `undo`. The other slots keep their order.
+  void RetireSlots(Color color, const Bitboard& cells, Undo* undo);
+
+  // The maximum number of slots a single color can accumulate: one for the
+  // starting corner, plus the most slots of any orientation of each tile.
+  static const int kMaxSlots = 113;
+
+  // Bitwise representation of the pieces on the board, one for each color.
+  Bitboard pieces_[5];
+  // Zobrist hash of pieces_.
+  uint64_t hash_ = 0;
+
+  // Bitwise representation of the board, one for each color.
   // A "1" means that the (row, col) is available for a piece, while a "0" means
   // that it is occupied.
-  std::vector<std::vector<uint32_t>> available_;
-
-  // Information about a "slot" on the board.
-  // A slot represents a possible place that a piece corner could go, basically
-  // any spot next to a corner of an existing piece.
-  struct SlotInfo {
-    // The actual slot itself.
-    Slot slot;
-    // A cache of possible tiles on this slot.
-    // This is mutable so that it can be updated in the const PossibleMoves.
-    // TODO(piotrf): consider refactoring the API, this is a hack.
-    mutable uint32_t possible_tiles;
-
-    explicit SlotInfo(const Slot& a_slot)
-        : slot(a_slot), possible_tiles(0xffffffff) {}
-
-    bool IsAvailable(const Tile& tile) const {
-      return possible_tiles & (1 << tile.index());
-    }
-
-    void SetUnavailable(const Tile& tile) const {
-      possible_tiles &= ~(1 << tile.index());
-    }
-  };
-  std::vector<std::vector<SlotInfo>> slots_;
+  Bitboard available_[5];
+
+  // Slots for each color, only the first num_slots_[color] are valid. A slot
+  // is a place that a piece corner could go, next to a corner of the color's
+  // pieces. There is exactly one slot on every cell of the color's frontier.
+  // The slots add the direction they face, which the slots move generator uses
+  // for pruning.
+  Slot slots_[5][kMaxSlots];
+  int num_slots_[5];
+
+  // The cells where each color can attach a new tile, see frontier().
+  Bitboard frontier_[5];
 
-  // A map from a position on the board, represented by a flat integer,
-  // to whether or not a slot exists at that position. Used to dedup multiple
-  // slots on the same position.
-  std::vector<std::vector<bool>> slot_map_;
+  // Tiles that each color can't place anywhere, see dead_tiles().
+  uint32_t dead_tiles_[5];
+  // A placement that fits for each tile that isn't dead. A tile can only die
+  // when its placement here stops fitting, and only then does MakeMove look
+  // for another one. UnmakeMove leaves these alone, since they still fit
+  // after giving cells back.
+  MoveId fits_[5][kNumTiles];
+  // Covers the placements in fits_ of each color's tiles that aren't dead, so
+  // that most moves take a single check.
+  Bitboard fits_cells_[5];
+
+  // The move generator, fixed when the board is constructed since the
+  // incremental generator needs to see every move.
+  MoveGenerator move_generator_;
+
+  // For the incremental generator only: the legal moves of each color, see
+  // AttachLegalMoves. Only tiles in tracked_tiles_ are kept up to date, since
+  // a color can't play a tile twice.
+  LegalMoves* legal_moves_ = nullptr;
+  uint32_t tracked_tiles_[5];
+  // Cells that became unavailable to each color since its last update.
+  Bitboard stale_cells_[5];
+  // Slots from this index on were added since each color's last update.
+  int first_new_slot_[5];
+  // Counts the updates of each color's legal moves, so that UnmakeMove can
+  // tell if legal_moves_ has changed since the move was made.
+  uint32_t num_updates_[5];
+  // Set by UnmakeMove when legal_moves_ has to be rebuilt from scratch, since
+  // updates can't be reversed.
+  bool rebuild_legal_[5];
 };
 
 inline bool operator==(const Move& lhs, const Move& rhs) {
@@ -95,6 +306,14 @@ inline bool operator==(const Move& lhs, const Move& rhs) {
   return lhs.placement == rhs.placement;
 }
 
+static_assert(Board::kNumRows == Bitboard::kNumRows &&
+              Board::kNumCols == Bitboard::kNumCols,
+              "Board and Bitboard dimensions must match");
+// Copying a Board should be a plain memcpy, since games are copied for every
+// MCTS iteration and rollout.
+static_assert(std::is_trivially_copyable<Board>::value,
+              "Board must be trivially copyable");
+
 }  // namespace blokus
 
 #endif
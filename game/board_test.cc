@@ -1,7 +1,10 @@
 #include "game/board.h"
 
+#include <memory>
 #include <random>
 
+#include "absl/flags/flag.h"
+#include "absl/flags/reflection.h"
 #include "absl/log/log.h"
 #include "absl/strings/str_cat.h"
 #include "gmock/gmock.h"
@@ -411,6 +414,64 @@ TEST(BoardTest, PossibleMoves_PlayedLadder) {
   EXPECT_THAT(moves[2].placement.flip, Eq(true));
 }
 
+TEST(BoardTest, Frontier) {
+  Board board;
+  Bitboard expected;
+  expected.Set(0, 0);
+  EXPECT_THAT(board.frontier(BLUE), Eq(expected));
+
+  // Play the 2x1 in the corner, and then the 1x1 diagonal to it.
+  Move move;
+  move.color = BLUE;
+  move.tile = 1;
+  move.placement.coord = Coord(0, 0);
+  ASSERT_TRUE(board.MakeMove(move));
+  expected = Bitboard();
+  expected.Set(1, 2);
+  EXPECT_THAT(board.frontier(BLUE), Eq(expected));
+
+  move.tile = 0;
+  move.placement.coord = Coord(1, 2);
+  Board::Undo undo;
+  ASSERT_TRUE(board.MakeMove(move, &undo));
+  expected = Bitboard();
+  expected.Set(0, 3);
+  expected.Set(2, 1);
+  expected.Set(2, 3);
+  EXPECT_THAT(board.frontier(BLUE), Eq(expected));
+
+  // Taking the move back restores the frontier.
+  board.UnmakeMove(move, undo);
+  expected = Bitboard();
+  expected.Set(1, 2);
+  EXPECT_THAT(board.frontier(BLUE), Eq(expected));
+}
+
+// Plays random moves for every color in turn until none of them can move,
+// checking that HasMoves agrees with the moves found.
+TEST(BoardTest, HasMoves) {
+  Board board;
+  std::mt19937 eng(1);
+  bool any_moves = true;
+  while (any_moves) {
+    any_moves = false;
+    for (Color color : {BLUE, YELLOW, RED, GREEN}) {
+      std::vector<Move> moves;
+      for (int tile = 0; tile < kNumTiles; ++tile) {
+        if (board.dead_tiles(color) & (1u << tile)) continue;
+        for (const Move& move : board.PossibleMoves(kTiles[tile], color)) {
+          moves.push_back(move);
+        }
+      }
+      ASSERT_THAT(board.HasMoves(color), Eq(!moves.empty()));
+      if (moves.empty()) continue;
+      any_moves = true;
+      std::uniform_int_distribution<int> dist(0, moves.size() - 1);
+      ASSERT_TRUE(board.MakeMove(moves[dist(eng)]));
+    }
+  }
+}
+
 std::string PrintMoves(const std::vector<Move>& moves) {
   std::string out;
   for (int i = 0; i < moves.size(); ++i) {
@@ -420,10 +481,15 @@ std::string PrintMoves(const std::vector<Move>& moves) {
 }
 
 // Plays a random game, comparing possible moves when using Board vs. possible
-// moves when using VerificationBoard.
-TEST(BoardTest, MatchesVerificationBoard) {
+// moves when using VerificationBoard. If `unmake_moves` is set, Board also
+// makes and takes back a different random move before every real one.
+void PlayAgainstVerificationBoard(bool unmake_moves = false) {
   Board board;
   VerificationBoard ver_board;
+  auto legal_moves = std::make_unique<LegalMoves>();
+  if (board.move_generator() == MoveGenerator::kIncremental) {
+    board.AttachLegalMoves(legal_moves.get());
+  }
 
   std::mt19937 eng(0);
 
@@ -439,7 +505,7 @@ TEST(BoardTest, MatchesVerificationBoard) {
         if (a.placement.rotation < b.placement.rotation) return true;
         if (a.placement.rotation > b.placement.rotation) return false;
 
-        if (!a.placement.flip) return true;
+        return !a.placement.flip && b.placement.flip;
       };
 
   // Everyone starts with all tiles.
@@ -453,6 +519,7 @@ TEST(BoardTest, MatchesVerificationBoard) {
     LOG(INFO) << "Round " << round;
     for (Color color : {BLUE, YELLOW, RED, GREEN}) {
       LOG(INFO) << ColorToString(color) << "'s turn";
+      board.UpdateLegalMoves(color);
       std::vector<Move> all_moves;
       for (int tile = 0; tile < kNumTiles; ++tile) {
         if (!player_tiles[color][tile]) continue;
@@ -480,6 +547,14 @@ TEST(BoardTest, MatchesVerificationBoard) {
       // Now, pick a move at random and make it.
       std::uniform_int_distribution<int> dist(0, all_moves.size() - 1);
       int move_idx = dist(eng);
+      if (unmake_moves) {
+        const Move& probe = all_moves[dist(eng)];
+        LOG(INFO) << "  => Making and unmaking move " << probe.DebugString();
+        Board::Undo undo;
+        ASSERT_TRUE(board.MakeMove(probe, &undo));
+        board.UpdateLegalMoves(NextColor(color));
+        board.UnmakeMove(probe, undo);
+      }
       LOG(INFO) << "  => Making move " << all_moves[move_idx].DebugString();
       board.MakeMove(all_moves[move_idx]);
       ver_board.MakeMove(all_moves[move_idx]);
@@ -489,5 +564,31 @@ TEST(BoardTest, MatchesVerificationBoard) {
   }
 }
 
+TEST(BoardTest, MatchesVerificationBoard) {
+  PlayAgainstVerificationBoard();
+}
+
+TEST(BoardTest, BitboardMoveGeneratorMatchesVerificationBoard) {
+  absl::FlagSaver flag_saver;
+  absl::SetFlag(&FLAGS_move_generator, MoveGenerator::kBitboard);
+  PlayAgainstVerificationBoard();
+}
+
+TEST(BoardTest, IncrementalMoveGeneratorMatchesVerificationBoard) {
+  absl::FlagSaver flag_saver;
+  absl::SetFlag(&FLAGS_move_generator, MoveGenerator::kIncremental);
+  PlayAgainstVerificationBoard();
+}
+
+TEST(BoardTest, UnmakeMoveMatchesVerificationBoard) {
+  for (MoveGenerator generator :
+       {MoveGenerator::kSlots, MoveGenerator::kBitboard,
+        MoveGenerator::kIncremental}) {
+    absl::FlagSaver flag_saver;
+    absl::SetFlag(&FLAGS_move_generator, generator);
+    PlayAgainstVerificationBoard(/*unmake_moves=*/true);
+  }
+}
+
 }  // namespace
 }  // namespace blokus
@@ -1,91 +1,236 @@
 #include "game/game.h"
 
-#include <set>
-
 #include "absl/log/check.h"
 
+#include "game/zobrist.h"
+
 namespace blokus {
 
 Game::Game(int num_players) : num_players_(num_players) {
   CHECK(num_players_ == 2 || num_players_ == 4);
-  player_tiles_[BLUE] = std::vector<bool>(kNumTiles, true);
-  player_tiles_[YELLOW] = std::vector<bool>(kNumTiles, true);
-  player_tiles_[RED] = std::vector<bool>(kNumTiles, true);
-  player_tiles_[GREEN] = std::vector<bool>(kNumTiles, true);
-  players_with_moves_ = {BLUE, YELLOW, RED, GREEN};
+  for (Color color : {BLUE, YELLOW, RED, GREEN}) {
+    player_tiles_[color] = (1u << kNumTiles) - 1;
+    players_with_moves_ |= 1 << color;
+    for (int tile = 0; tile < kNumTiles; ++tile) {
+      hash_ ^= kZobristKeys.tiles[color][tile];
+    }
+  }
+  hash_ ^= kZobristKeys.to_move[current_color_];
+  board_.UpdateLegalMoves(current_color_);
+}
+
+void Game::AttachLegalMoves(LegalMoves* legal_moves) {
+  board_.AttachLegalMoves(legal_moves);
+  board_.UpdateLegalMoves(current_color_);
 }
 
 bool Game::MakeMove(const Move& move) {
+  Undo undo;
+  return MakeMove(move, &undo);
+}
+
+bool Game::MakeMove(const Move& move, Undo* undo) {
   if (move.color != current_color_) return false;
+  const uint8_t color_bit = 1 << move.color;
+  undo->had_moves = players_with_moves_ & color_bit;
+  undo->played_one_last = played_one_last_ & color_bit;
   if (move.tile == -1) {
-    players_with_moves_.erase(move.color);
+    if (undo->had_moves) {
+      players_with_moves_ &= ~color_bit;
+      hash_ ^= kZobristKeys.passed[move.color];
+    }
   } else {
     // Once you pass, you can't keep playing.
-    if (players_with_moves_.count(move.color) == 0) {
+    if (!undo->had_moves) {
       // TODO(piotrf): re-enable vlog once absl supports it
       //  VLOG(1) << ColorToString(move.color) << " already passed";
       return false;
     }
     
     // Ensure that this tile is still available.
-    if (!player_tiles_[current_color_][move.tile]) {
+    if (move.tile < 0 || move.tile >= kNumTiles ||
+        !HasTile(current_color_, move.tile)) {
       // TODO(piotrf): re-enable vlog once absl supports it
       //  VLOG(1) << ColorToString(move.color) << " played an already played tile";
       return false;
     }
     
     // Try making the move.
-    if (!board_.MakeMove(move)) {
+    if (!board_.MakeMove(move, &undo->board)) {
       // TODO(piotrf): re-enable vlog once absl supports it
       //  VLOG(1) << ColorToString(move.color) << " doesn't fit the board";
       return false;
     }
 
     // If we succeeded, mark the tile as used.
-    player_tiles_[current_color_][move.tile] = false;
+    player_tiles_[current_color_] &= ~(1u << move.tile);
+    hash_ ^= kZobristKeys.tiles[move.color][move.tile];
 
     if (move.tile == 0) {
-      played_one_last_.insert(move.color);
+      played_one_last_ |= color_bit;
     } else {
-      played_one_last_.erase(move.color);
+      played_one_last_ &= ~color_bit;
+    }
+    if (undo->played_one_last != (move.tile == 0)) {
+      hash_ ^= kZobristKeys.played_one_last[move.color];
     }
   }
 
-  moves_.push_back(move);
-  current_color_ = NextColor(current_color_);
-  current_player_ = (current_player_ + 1) % num_players_;
+  Move& recent_move = recent_moves_[num_moves_ % kNumRecentMoves];
+  undo->move = move;
+  undo->dropped_move = recent_move;
+  recent_move = move;
+  ++num_moves_;
+  // Colors that passed can't move anymore, so they don't get a turn, and
+  // colors that can't move anymore pass right away. Once every color has
+  // passed, the game is over and the turn just moves on.
+  hash_ ^= kZobristKeys.to_move[current_color_];
+  undo->auto_passed = 0;
+  do {
+    current_color_ = NextColor(current_color_);
+    const uint8_t next_bit = 1 << current_color_;
+    if ((players_with_moves_ & next_bit) &&
+        !board_.HasMoves(current_color_)) {
+      players_with_moves_ &= ~next_bit;
+      undo->auto_passed |= next_bit;
+      hash_ ^= kZobristKeys.passed[current_color_];
+    }
+  } while (players_with_moves_ != 0 &&
+           !(players_with_moves_ & (1 << current_color_)));
+  current_player_ = PlayerOf(current_color_);
+  hash_ ^= kZobristKeys.to_move[current_color_];
+  board_.UpdateLegalMoves(current_color_);
 
   return true;
 }
 
+void Game::UnmakeMove(const Undo& undo) {
+  CHECK_GT(num_moves_, 0);
+  const Move& move = undo.move;
+  const uint8_t color_bit = 1 << move.color;
+  if (move.tile == -1) {
+    if (undo.had_moves) {
+      players_with_moves_ |= color_bit;
+      hash_ ^= kZobristKeys.passed[move.color];
+    }
+  } else {
+    board_.UnmakeMove(move, undo.board);
+    player_tiles_[move.color] |= 1u << move.tile;
+    hash_ ^= kZobristKeys.tiles[move.color][move.tile];
+    if (undo.played_one_last) {
+      played_one_last_ |= color_bit;
+    } else {
+      played_one_last_ &= ~color_bit;
+    }
+    if (undo.played_one_last != (move.tile == 0)) {
+      hash_ ^= kZobristKeys.played_one_last[move.color];
+    }
+  }
+
+  for (Color color : {BLUE, YELLOW, RED, GREEN}) {
+    if (undo.auto_passed & (1 << color)) {
+      players_with_moves_ |= 1 << color;
+      hash_ ^= kZobristKeys.passed[color];
+    }
+  }
+
+  hash_ ^= kZobristKeys.to_move[current_color_];
+  current_color_ = move.color;
+  hash_ ^= kZobristKeys.to_move[current_color_];
+  current_player_ = PlayerOf(current_color_);
+  --num_moves_;
+  recent_moves_[num_moves_ % kNumRecentMoves] = undo.dropped_move;
+  board_.UpdateLegalMoves(current_color_);
+}
+
+const Move& Game::recent_move(int i) const {
+  DCHECK_GE(i, 0);
+  DCHECK_LT(i, kNumRecentMoves);
+  DCHECK_LT(i, num_moves_);
+  return recent_moves_[(num_moves_ - 1 - i) % kNumRecentMoves];
+}
+
 std::vector<Move> Game::PossibleMoves() const {
+  MoveList ids;
+  GenerateMoves(&ids);
   std::vector<Move> moves;
-  for (int tile = 0; tile < kNumTiles; ++tile) {
-    if (!player_tiles_.at(current_color_)[tile]) continue;
-    std::vector<Move> tile_moves = board_.PossibleMoves(
-        kTiles[tile], current_color_);
-    moves.insert(moves.end(), tile_moves.begin(), tile_moves.end());
+  moves.reserve(ids.size());
+  for (MoveId id : ids) {
+    moves.push_back(ToMove(id, current_color_));
   }
   return moves;
 }
 
+void Game::GenerateMoves(MoveList* moves) const {
+  moves->clear();
+  // Once you pass, you can't keep playing.
+  if (!(players_with_moves_ & (1 << current_color_))) return;
+  // Skip the tiles that can't be placed anywhere without even looking.
+  for (uint32_t tiles = player_tiles_[current_color_] &
+                        ~board_.dead_tiles(current_color_);
+       tiles; tiles &= tiles - 1) {
+    const int tile = __builtin_ctz(tiles);
+    moves->Grow(
+        board_.GenerateMoves(kTiles[tile], current_color_, moves->unused()));
+  }
+}
+
+int Game::CountMoves() const {
+  int tile_counts[kNumTiles];
+  return CountMoves(tile_counts);
+}
+
+int Game::CountMoves(int tile_counts[kNumTiles]) const {
+  // Once you pass, you can't keep playing.
+  if (!(players_with_moves_ & (1 << current_color_))) return 0;
+  int num_moves = 0;
+  for (uint32_t tiles = player_tiles_[current_color_] &
+                        ~board_.dead_tiles(current_color_);
+       tiles; tiles &= tiles - 1) {
+    const int tile = __builtin_ctz(tiles);
+    tile_counts[tile] = board_.CountMoves(kTiles[tile], current_color_);
+    num_moves += tile_counts[tile];
+  }
+  return num_moves;
+}
+
+MoveId Game::NthMove(int tile, int n) const {
+  return board_.NthMove(kTiles[tile], current_color_, n);
+}
+
+MoveId Game::SampleMove(Rng* rng) const {
+  if (!board_.CountsMovesCheaply()) {
+    // Counting the moves would find them all, so try random placements.
+    if (!(players_with_moves_ & (1 << current_color_))) return kPassMoveId;
+    return board_.SampleMove(current_color_, rng);
+  }
+
+  int tile_counts[kNumTiles] = {};
+  const int num_moves = CountMoves(tile_counts);
+  if (num_moves == 0) return kPassMoveId;
+  int n = rng->Uniform(num_moves);
+  int tile = 0;
+  while (n >= tile_counts[tile]) {
+    n -= tile_counts[tile++];
+  }
+  return NthMove(tile, n);
+}
+
 bool Game::Finished() const {
-  return players_with_moves_.empty();
+  return players_with_moves_ == 0;
 }
 
 GameResult Game::Result() const {
   // Score each color.
-  std::map<Color, int> color_to_score;
+  int color_to_score[5] = {};
   for (Color color : {BLUE, YELLOW, RED, GREEN}) {
     // Compute the score.
     int score = 0;
-    for (int tile = 0; tile < 21; ++tile) {
-      if (player_tiles_.at(color)[tile]) {
-        score -= kTiles[tile].Size();
-      }
+    for (uint32_t tiles = player_tiles_[color]; tiles; tiles &= tiles - 1) {
+      score -= kTiles[__builtin_ctz(tiles)].Size();
     }
     if (score == 0) {
-      if (played_one_last_.count(color)) score = 20;
+      if (played_one_last_ & (1 << color)) score = 20;
       else score = 15;
     }
     color_to_score[color] = score;
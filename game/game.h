@@ -1,11 +1,12 @@
 #ifndef BLOKUS_GAME_GAME_H_
 #define BLOKUS_GAME_GAME_H_
 
-#include <map>
-#include <set>
+#include <cstdint>
+#include <type_traits>
 #include <vector>
 
 #include "game/board.h"
+#include "game/rng.h"
 
 namespace blokus {
 
@@ -25,16 +26,62 @@ class Game {
  public:
   // Create a game for `num_players` players, which must be either 2 or 4.
   explicit Game(int num_players);
+
+  // The number of most recent moves that the game keeps, enough to see every
+  // move since a player's previous turn.
+  static constexpr int kNumRecentMoves = 4;
+
+  // Everything needed to take back a move, filled in by MakeMove.
+  struct Undo {
+    Board::Undo board;
+    // The move itself, and the recent move that it pushed out.
+    Move move;
+    Move dropped_move;
+    // Whether the moving color was still playing before the move.
+    bool had_moves;
+    // The colors that had no moves left after the move, and passed without
+    // getting a turn.
+    uint8_t auto_passed;
+    // Whether the moving color had played the '1' tile last before the move.
+    bool played_one_last;
+  };
   
   // Make a move for the current player color.
-  // If the move is valid, returns true and advances to the next player.
-  // Otherwise returns false and stays in the same state.
+  // If the move is valid, returns true and advances to the next color that
+  // can still move. Colors that have passed are skipped, and colors that have
+  // no moves left pass without getting a turn. Otherwise returns false and
+  // stays in the same state.
   bool MakeMove(const Move& move);
 
+  // Like the above, but also fills in `undo` so that the move can be taken
+  // back with UnmakeMove.
+  bool MakeMove(const Move& move, Undo* undo);
+
+  // Takes back the last move, using the `undo` that MakeMove filled in for it.
+  // This is much cheaper than copying the game before making the move.
+  void UnmakeMove(const Undo& undo);
+
+  // Makes the board keep its legal moves in `legal_moves`, see
+  // Board::AttachLegalMoves.
+  void AttachLegalMoves(LegalMoves* legal_moves);
+
   // Returns a list of possible moves that the current player color can play.
   std::vector<Move> PossibleMoves() const;
 
-  // Returns true if the game is finished.
+  // Like the above, but replaces `moves` with the ids of the moves, without
+  // allocating. Use ToMove with current_color() to get the moves back.
+  void GenerateMoves(MoveList* moves) const;
+
+  // Returns the number of possible moves, without listing them.
+  int CountMoves() const;
+
+  // Returns one of the possible moves, chosen uniformly at random with `rng`,
+  // or kPassMoveId if there are none. When the board can count moves cheaply,
+  // only the moves of the chosen tile are listed. Otherwise this uses
+  // Board::SampleMove, which usually lists none.
+  MoveId SampleMove(Rng* rng) const;
+
+  // Returns true if the game is finished, i.e. no color can move anymore.
   bool Finished() const;
 
   // Returns the final result of the game.
@@ -43,11 +90,42 @@ class Game {
 
   int num_players() const { return num_players_; }
   int current_player() const { return current_player_; }
+  // Returns the id of the player who plays `color`.
+  int PlayerOf(Color color) const { return (color - BLUE) % num_players_; }
   Color current_color() const { return current_color_; }
   const Board& board() const { return board_; }
-  const std::vector<Move>& moves() const { return moves_; }
+
+  // The number of moves made so far, including passes.
+  int num_moves() const { return num_moves_; }
+
+  // Returns the `i`th most recent move, starting from 0 for the last move.
+  // Only the last kNumRecentMoves moves are kept, and `i` must be less than
+  // num_moves(). The full history is up to whoever is playing the game, see
+  // GameRunner.
+  const Move& recent_move(int i) const;
+
+  // Returns true if `color` still has the given tile.
+  bool HasTile(Color color, int tile) const {
+    return player_tiles_[color] & (1u << tile);
+  }
+
+  // Returns a Zobrist hash of the position: the pieces on the board, the tiles
+  // each color has left, the color to move, and which colors have passed or
+  // played the '1' tile last.
+  // Games that reach the same position by different move orders have the same
+  // hash.
+  uint64_t hash() const { return board_.hash() ^ hash_; }
   
  private:
+  // Like CountMoves, but also sets tile_counts[tile] to the number of moves of
+  // each tile of the current color. Tiles the color doesn't have are left
+  // alone.
+  int CountMoves(int tile_counts[kNumTiles]) const;
+
+  // Returns the `n`th move of the current color's `tile`, see
+  // Board::NthMove.
+  MoveId NthMove(int tile, int n) const;
+
   int num_players_;
   // The current player id.
   int current_player_ = 0;
@@ -56,16 +134,31 @@ class Game {
 
   // The game board.
   Board board_;
-  // List of all played moves.
-  std::vector<Move> moves_;
-  // Map from color to a bool per tile. True means the tile hasn't been played.
-  std::map<Color, std::vector<bool>> player_tiles_;
-  // Set of all players who have not yet passed.
-  std::set<Color> players_with_moves_;
-  // Set of players who played the '1' tile as their last move.
-  std::set<Color> played_one_last_;
+  // The number of moves made, and the last few of them, with move i at
+  // recent_moves_[i % kNumRecentMoves].
+  int num_moves_ = 0;
+  Move recent_moves_[kNumRecentMoves];
+  // A mask per color with a bit per tile. Set means the tile hasn't been
+  // played.
+  uint32_t player_tiles_[5] = {};
+  // Bit `color` is set for the colors that have not yet passed. Colors pass
+  // as soon as their turn comes with no moves left, so when the game isn't
+  // finished, the current color has moves.
+  uint8_t players_with_moves_ = 0;
+  // Bit `color` is set for the colors that played the '1' tile as their last
+  // move.
+  uint8_t played_one_last_ = 0;
+  // Zobrist hash of everything but the board.
+  uint64_t hash_ = 0;
 };
 
+// Like Board, copying a Game should be a plain memcpy.
+static_assert(std::is_trivially_copyable<Game>::value,
+              "Game must be trivially copyable");
+// It should also stay small, currently about 8KB. Anything big that only some
+// games need, like LegalMoves, belongs outside of it.
+static_assert(sizeof(Game) <= 9 * 1024, "Game is copied too often to grow");
+
 }  // namespace blokus
 
 #endif
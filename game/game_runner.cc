@@ -28,6 +28,9 @@ GameResult GameRunner::Play() {
     CHECK(game.MakeMove(move))
         << ColorToString(game.current_color()) << " (player " << current_player
         << ") wants to play an invalid move: " << move.DebugString();
+    for (auto& player : players_) {
+      player->MoveMade(game, move);
+    }
     for (auto& observer : observers_) {
       observer(game, move);
     }
@@ -0,0 +1,388 @@
+#include "game/game.h"
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/reflection.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace blokus {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Ne;
+
+// Returns a string describing everything about the game that is visible
+// through its public API.
+std::string GameState(const Game& game) {
+  std::string state;
+  for (int row = 0; row < Board::kNumRows; ++row) {
+    for (int col = 0; col < Board::kNumCols; ++col) {
+      state += '0' + game.board().PieceAt(row, col);
+    }
+  }
+  state += ' ';
+  state += std::to_string(game.current_player());
+  state += ' ';
+  state += ColorToString(game.current_color());
+  state += ' ';
+  state += std::to_string(game.num_moves());
+  for (Color color : {BLUE, YELLOW, RED, GREEN}) {
+    state += ' ';
+    for (int tile = 0; tile < kNumTiles; ++tile) {
+      state += game.HasTile(color, tile) ? '1' : '0';
+    }
+    state += ' ';
+    state += std::to_string(game.board().dead_tiles(color));
+  }
+  // The order of possible moves depends on the order of earlier moves.
+  std::vector<std::string> moves;
+  for (const Move& move : game.PossibleMoves()) {
+    moves.push_back(move.DebugString());
+  }
+  std::sort(moves.begin(), moves.end());
+  for (const std::string& move : moves) {
+    state += ' ';
+    state += move;
+  }
+  return state;
+}
+
+// Gives `game` somewhere to keep its legal moves if it uses the incremental
+// generator. The returned moves must outlive the game.
+std::unique_ptr<LegalMoves> AttachLegalMoves(Game* game) {
+  auto legal_moves = std::make_unique<LegalMoves>();
+  if (game->board().move_generator() == MoveGenerator::kIncremental) {
+    game->AttachLegalMoves(legal_moves.get());
+  }
+  return legal_moves;
+}
+
+// Plays one of the possible moves of `game`, chosen at random with `rng`, and
+// returns it. Colors without moves pass before their turn, so there always is
+// one until the game is finished.
+Move PlayRandomMove(Game* game, Rng* rng) {
+  const std::vector<Move> moves = game->PossibleMoves();
+  Move move = Move::EmptyMove(game->current_color());
+  if (moves.empty()) {
+    ADD_FAILURE() << ColorToString(game->current_color()) << " has no moves";
+  } else {
+    move = moves[rng->Uniform(moves.size())];
+  }
+  EXPECT_TRUE(game->MakeMove(move)) << move.DebugString();
+  return move;
+}
+
+// Calls `fn` once with each move generator.
+void ForEachGenerator(const std::function<void()>& fn) {
+  for (MoveGenerator generator :
+       {MoveGenerator::kSlots, MoveGenerator::kBitboard,
+        MoveGenerator::kIncremental}) {
+    SCOPED_TRACE(AbslUnparseFlag(generator));
+    absl::FlagSaver flag_saver;
+    absl::SetFlag(&FLAGS_move_generator, generator);
+    fn();
+  }
+}
+
+// Returns the moves that the game keeps as a string.
+std::string RecentMoves(const Game& game) {
+  std::string moves;
+  for (int i = 0; i < std::min(game.num_moves(), Game::kNumRecentMoves); ++i) {
+    moves += game.recent_move(i).DebugString();
+    moves += '\n';
+  }
+  return moves;
+}
+
+TEST(GameTest, UnmakeMoveRestoresState) {
+  Rng rng(0);
+  Game game(4);
+  std::vector<Game> history;
+  std::vector<Game::Undo> undos;
+  while (!game.Finished()) {
+    // Play a random move on a copy, to find the move to make with an undo.
+    Game next = game;
+    const Move move = PlayRandomMove(&next, &rng);
+    history.push_back(game);
+    undos.emplace_back();
+    ASSERT_TRUE(game.MakeMove(move, &undos.back()));
+  }
+
+  // Take back every move, including the one that ended the game.
+  while (!history.empty()) {
+    game.UnmakeMove(undos.back());
+    undos.pop_back();
+    ASSERT_FALSE(game.Finished());
+    ASSERT_THAT(GameState(game), Eq(GameState(history.back())));
+    ASSERT_THAT(RecentMoves(game), Eq(RecentMoves(history.back())));
+    ASSERT_THAT(game.hash(), Eq(history.back().hash()));
+    history.pop_back();
+  }
+}
+
+// Plays a game in which every move is preceded by trying out, and taking back,
+// a different move. Checks that it stays in sync with a game without these.
+void PlayWithTakenBackMoves() {
+  Rng rng(1);
+  Game game(2);
+  Game replay(2);
+  auto legal_moves = AttachLegalMoves(&game);
+  Game::Undo undo;
+  while (!game.Finished()) {
+    std::vector<Move> moves = game.PossibleMoves();
+    if (!moves.empty()) {
+      ASSERT_TRUE(game.MakeMove(moves[rng.Uniform(moves.size())], &undo));
+      game.UnmakeMove(undo);
+    }
+    ASSERT_TRUE(replay.MakeMove(PlayRandomMove(&game, &rng)));
+    ASSERT_THAT(GameState(game), Eq(GameState(replay)));
+    ASSERT_THAT(game.hash(), Eq(replay.hash()));
+  }
+  EXPECT_TRUE(replay.Finished());
+}
+
+TEST(GameTest, UnmakeMoveMatchesReplay) {
+  ForEachGenerator(PlayWithTakenBackMoves);
+}
+
+// Plays a random game, checking at every move that the ids from
+// GenerateMoves are exactly the possible moves.
+void PlayWithMoveIds() {
+  Rng rng(3);
+  Game game(4);
+  auto legal_moves = AttachLegalMoves(&game);
+  MoveList ids;
+  while (!game.Finished()) {
+    std::vector<Move> moves = game.PossibleMoves();
+    game.GenerateMoves(&ids);
+    ASSERT_THAT(ids.size(), Eq(moves.size()));
+    for (size_t i = 0; i < moves.size(); ++i) {
+      ASSERT_THAT(ToMove(ids[i], game.current_color()), Eq(moves[i]));
+      ASSERT_THAT(ToMoveId(moves[i]), Eq(ids[i]));
+    }
+    PlayRandomMove(&game, &rng);
+  }
+}
+
+TEST(GameTest, GenerateMovesMatchesPossibleMoves) {
+  ForEachGenerator(PlayWithMoveIds);
+}
+
+TEST(GameTest, SkipsPassedColors) {
+  Game game(2);
+  ASSERT_TRUE(game.MakeMove(game.PossibleMoves().back()));
+  ASSERT_TRUE(game.MakeMove(Move::EmptyMove(YELLOW)));
+  ASSERT_TRUE(game.MakeMove(game.PossibleMoves().back()));
+  EXPECT_THAT(game.current_color(), Eq(GREEN));
+  EXPECT_THAT(game.current_player(), Eq(1));
+
+  ASSERT_TRUE(game.MakeMove(game.PossibleMoves().back()));
+  EXPECT_THAT(game.current_color(), Eq(BLUE));
+
+  // Yellow passed, so red follows blue.
+  ASSERT_TRUE(game.MakeMove(game.PossibleMoves().back()));
+  EXPECT_THAT(game.current_color(), Eq(RED));
+  EXPECT_THAT(game.current_player(), Eq(0));
+  EXPECT_FALSE(game.MakeMove(Move::EmptyMove(YELLOW)));
+
+  // The game is over as soon as the last color passes.
+  ASSERT_TRUE(game.MakeMove(Move::EmptyMove(RED)));
+  ASSERT_TRUE(game.MakeMove(Move::EmptyMove(GREEN)));
+  EXPECT_THAT(game.current_color(), Eq(BLUE));
+  ASSERT_TRUE(game.MakeMove(Move::EmptyMove(BLUE)));
+  EXPECT_TRUE(game.Finished());
+  EXPECT_THAT(game.num_moves(), Eq(8));
+}
+
+TEST(GameTest, PassesColorsWithoutMoves) {
+  Rng rng(9);
+  Game game(4);
+  int num_tiles_played = 0;
+  while (!game.Finished()) {
+    // PlayRandomMove checks that the current color has moves.
+    PlayRandomMove(&game, &rng);
+    ++num_tiles_played;
+  }
+  // Nobody played a pass, the colors stopped getting turns instead.
+  EXPECT_THAT(game.num_moves(), Eq(num_tiles_played));
+  for (Color color : {BLUE, YELLOW, RED, GREEN}) {
+    EXPECT_FALSE(game.board().HasMoves(color)) << ColorToString(color);
+  }
+}
+
+TEST(GameTest, DeadTilesStayDead) {
+  Rng rng(5);
+  Game game(4);
+  uint32_t dead_tiles[5] = {};
+  while (!game.Finished()) {
+    std::vector<Move> moves = game.PossibleMoves();
+    const Color color = game.current_color();
+    const uint32_t dead = game.board().dead_tiles(color);
+    EXPECT_THAT(dead & dead_tiles[color], Eq(dead_tiles[color]));
+    dead_tiles[color] = dead;
+    for (const Move& move : moves) {
+      EXPECT_FALSE(dead & (1u << move.tile)) << move.DebugString();
+    }
+    PlayRandomMove(&game, &rng);
+  }
+  // By the end of this game, blue has no room for one of its tiles.
+  EXPECT_NE(dead_tiles[BLUE], 0);
+}
+
+// Plays a random game, checking every few moves that CountMoves counts the
+// possible moves, and that SampleMove finds all of them and nothing else.
+void PlayWithSampledMoves() {
+  Rng rng(6);
+  Game game(4);
+  auto legal_moves = AttachLegalMoves(&game);
+  while (!game.Finished()) {
+    std::vector<Move> moves = game.PossibleMoves();
+    ASSERT_THAT(game.CountMoves(), Eq(moves.size()));
+    if (game.num_moves() % 8 == 0) {
+      std::set<MoveId> ids;
+      for (const Move& move : moves) {
+        ids.insert(ToMoveId(move));
+      }
+      // Every move is expected 20 times, so missing one is very unlikely.
+      std::set<MoveId> sampled;
+      for (size_t i = 0; i < 20 * moves.size(); ++i) {
+        sampled.insert(game.SampleMove(&rng));
+      }
+      ASSERT_THAT(sampled, Eq(ids));
+    }
+
+    const MoveId move = game.SampleMove(&rng);
+    ASSERT_THAT(move, Ne(kPassMoveId));
+    ASSERT_TRUE(game.MakeMove(ToMove(move, game.current_color())));
+  }
+}
+
+TEST(GameTest, SampleMoveMatchesPossibleMoves) {
+  ForEachGenerator(PlayWithSampledMoves);
+}
+
+// Checks that SampleMove picks every possible move about equally often in a
+// position where many moves touch more than one corner.
+void SampleInMidgame() {
+  Rng rng(8);
+  Game game(4);
+  for (int i = 0; i < 24; ++i) {
+    PlayRandomMove(&game, &rng);
+  }
+  const std::vector<Move> moves = game.PossibleMoves();
+  ASSERT_FALSE(moves.empty());
+  std::map<MoveId, int> counts;
+  for (const Move& move : moves) {
+    counts[ToMoveId(move)] = 0;
+  }
+  constexpr int kSamplesPerMove = 400;
+  for (size_t i = 0; i < kSamplesPerMove * moves.size(); ++i) {
+    const MoveId move = game.SampleMove(&rng);
+    ASSERT_TRUE(counts.count(move)) << move;
+    ++counts[move];
+  }
+  for (const auto& [move, count] : counts) {
+    EXPECT_GT(count, kSamplesPerMove / 2) << move;
+    EXPECT_LT(count, kSamplesPerMove * 3 / 2) << move;
+  }
+}
+
+TEST(GameTest, SampleMoveIsUniform) { ForEachGenerator(SampleInMidgame); }
+
+TEST(GameTest, CopiesDontUseLegalMoves) {
+  absl::FlagSaver flag_saver;
+  absl::SetFlag(&FLAGS_move_generator, MoveGenerator::kBitboard);
+  Game replay(4);
+  absl::SetFlag(&FLAGS_move_generator, MoveGenerator::kIncremental);
+  Game game(4);
+  auto legal_moves = AttachLegalMoves(&game);
+  Rng rng(7);
+  for (int i = 0; i < 8; ++i) {
+    ASSERT_TRUE(replay.MakeMove(PlayRandomMove(&game, &rng)));
+  }
+
+  // The original goes on while the copy replays a different game, and both
+  // still find the right moves.
+  Game copy = game;
+  for (int i = 0; i < 16; ++i) {
+    PlayRandomMove(&game, &rng);
+    ASSERT_TRUE(replay.MakeMove(PlayRandomMove(&copy, &rng)));
+    ASSERT_THAT(copy.PossibleMoves(), Eq(replay.PossibleMoves()));
+  }
+}
+
+TEST(GameTest, RecentMoves) {
+  Rng rng(4);
+  Game game(2);
+  std::vector<Move> history;
+  while (!game.Finished()) {
+    const Move move = PlayRandomMove(&game, &rng);
+    history.push_back(move);
+    ASSERT_THAT(game.num_moves(), Eq(history.size()));
+    for (int i = 0; i < std::min<int>(history.size(), Game::kNumRecentMoves);
+         ++i) {
+      ASSERT_THAT(game.recent_move(i), Eq(history[history.size() - 1 - i]));
+    }
+    if (move.tile != -1) {
+      EXPECT_FALSE(game.HasTile(move.color, move.tile));
+    }
+  }
+}
+
+TEST(GameTest, HashChangesWithEveryMove) {
+  Rng rng(2);
+  Game game(4);
+  std::set<uint64_t> hashes = {game.hash()};
+  while (!game.Finished()) {
+    PlayRandomMove(&game, &rng);
+    // Every move either adds a piece or a color that passed.
+    EXPECT_TRUE(hashes.insert(game.hash()).second);
+  }
+}
+
+TEST(GameTest, HashMatchesForTransposedMoves) {
+  // Everyone but blue passes, so that blue plays every turn, then blue plays
+  // two moves that don't interfere with each other, in both orders.
+  Game start(4);
+  ASSERT_TRUE(start.MakeMove(start.PossibleMoves().back()));
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_TRUE(start.MakeMove(Move::EmptyMove(start.current_color())));
+  }
+
+  auto play = [](Game game, const std::vector<Move>& blue_moves) {
+    for (const Move& move : blue_moves) {
+      if (!game.MakeMove(move)) return game;
+    }
+    return game;
+  };
+
+  std::vector<Move> moves = start.PossibleMoves();
+  for (const Move& a : moves) {
+    for (const Move& b : moves) {
+      // Playing the '1' tile last changes the score, so isn't a transposition.
+      if (a.tile == b.tile || a.tile == 0 || b.tile == 0) continue;
+      Game ab = play(start, {a, b});
+      Game ba = play(start, {b, a});
+      if (ab.num_moves() != start.num_moves() + 2 ||
+          ba.num_moves() != start.num_moves() + 2) {
+        continue;
+      }
+      EXPECT_THAT(ab.hash(), Eq(ba.hash()));
+      EXPECT_THAT(GameState(ab), Eq(GameState(ba)));
+      // Playing either move alone gives a different position.
+      EXPECT_NE(ab.hash(), play(start, {a}).hash());
+      return;
+    }
+  }
+  FAIL() << "No transposition found";
+}
+
+}  // namespace
+}  // namespace blokus
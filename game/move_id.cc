@@ -0,0 +1,248 @@
+#include "game/move_id.h"
+
+#include <array>
+#include <cstring>
+#include <vector>
+
+#include "absl/log/check.h"
+
+#include "game/bitboard.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define BLOKUS_HAVE_AVX2_KERNEL 1
+#endif
+
+namespace blokus {
+
+namespace {
+
+struct MoveIdTables {
+  // The first orientation of each tile, and the total at the end.
+  std::array<int, kNumTiles + 1> first_orientation;
+  // The orientations of all tiles.
+  std::vector<const TileOrientation*> orientations;
+  // Indexed by tile, rotation and flip, -1 if there is no such orientation.
+  int8_t orientation_index[kNumTiles][4][2];
+  // The first id of each orientation, and the number of columns its
+  // upper-left corner can be in.
+  std::array<int, kNumOrientations> first_id;
+  std::array<int, kNumOrientations> num_anchor_cols;
+  // Indexed by id.
+  std::vector<MoveIdInfo> infos;
+  std::vector<Bitboard> footprints;
+  std::vector<Bitboard> halos;
+  // The corner placements of each tile and cell are at
+  // corner_placements[first_corner_placement[i]...first_corner_placement[i+1]]
+  // with i = tile * kNumBits + Index(row, col).
+  std::vector<int> first_corner_placement;
+  std::vector<CornerPlacement> corner_placements;
+};
+
+// Returns the cells covered by placing `orientation` with its upper-left
+// corner at (row, col).
+Bitboard MakeFootprint(const TileOrientation& orientation, int row, int col) {
+  Bitboard footprint;
+  for (const Coord& coord : orientation.coords()) {
+    footprint.Set(row + coord.row(), col + coord.col());
+  }
+  return footprint;
+}
+
+// Returns the cells next to the edges of `footprint`.
+Bitboard MakeHalo(const Bitboard& footprint) {
+  Bitboard halo;
+  footprint.ForEach([&](int row, int col) {
+    if (row > 0) halo.Set(row - 1, col);
+    if (row + 1 < Bitboard::kNumRows) halo.Set(row + 1, col);
+    if (col > 0) halo.Set(row, col - 1);
+    if (col + 1 < Bitboard::kNumCols) halo.Set(row, col + 1);
+  });
+  return halo & ~footprint;
+}
+
+const MoveIdTables& Tables() {
+  static const auto* tables = []() {
+    auto* tables = new MoveIdTables;
+    std::memset(tables->orientation_index, -1,
+                sizeof tables->orientation_index);
+    tables->first_orientation[0] = 0;
+    for (int tile = 0; tile < kNumTiles; ++tile) {
+      for (const TileOrientation& orientation : kTiles[tile].orientations()) {
+        const int index = tables->orientations.size();
+        CHECK_LT(index, kNumOrientations);
+        tables->orientations.push_back(&orientation);
+        tables->orientation_index[tile][orientation.rotation()]
+                                 [orientation.flip()] = index;
+        tables->first_id[index] = tables->infos.size();
+        tables->num_anchor_cols[index] =
+            Bitboard::kNumCols - orientation.num_cols() + 1;
+        for (int row = 0; row + orientation.num_rows() <= Bitboard::kNumRows;
+             ++row) {
+          for (int col = 0;
+               col + orientation.num_cols() <= Bitboard::kNumCols; ++col) {
+            tables->infos.push_back(
+                MoveIdInfo{static_cast<uint8_t>(tile),
+                           static_cast<uint8_t>(index),
+                           static_cast<int8_t>(row),
+                           static_cast<int8_t>(col)});
+            tables->footprints.push_back(MakeFootprint(orientation, row, col));
+            tables->halos.push_back(MakeHalo(tables->footprints.back()));
+          }
+        }
+      }
+      tables->first_orientation[tile + 1] = tables->orientations.size();
+    }
+    CHECK_EQ(tables->orientations.size(), kNumOrientations);
+    CHECK_EQ(tables->infos.size(), kNumMoveIds);
+
+    // Group the placements by the cells their corners cover. For each
+    // orientation, going through the corners in order lists the placements of
+    // a cell in the order of the corners.
+    std::vector<std::vector<CornerPlacement>> by_cell(
+        kNumTiles * Bitboard::kNumBits);
+    for (int index = 0; index < kNumOrientations; ++index) {
+      const TileOrientation& orientation = *tables->orientations[index];
+      const int tile = tables->infos[tables->first_id[index]].tile;
+      for (const Corner& corner : orientation.corners()) {
+        for (int row = 0; row + orientation.num_rows() <= Bitboard::kNumRows;
+             ++row) {
+          for (int col = 0;
+               col + orientation.num_cols() <= Bitboard::kNumCols; ++col) {
+            const int cell = Bitboard::Index(row + corner.c.row(),
+                                             col + corner.c.col());
+            const MoveId id = tables->first_id[index] +
+                row * tables->num_anchor_cols[index] + col;
+            by_cell[tile * Bitboard::kNumBits + cell].push_back(
+                CornerPlacement{id, corner.type});
+          }
+        }
+      }
+    }
+    tables->first_corner_placement.push_back(0);
+    for (const std::vector<CornerPlacement>& placements : by_cell) {
+      // FittingPlacements returns a 64 bit mask.
+      CHECK_LE(placements.size(), 64);
+      tables->corner_placements.insert(tables->corner_placements.end(),
+                                       placements.begin(), placements.end());
+      tables->first_corner_placement.push_back(
+          tables->corner_placements.size());
+    }
+    return tables;
+  }();
+  return *tables;
+}
+
+uint64_t FittingPlacementsScalar(
+    const Bitboard& available, absl::Span<const CornerPlacement> placements) {
+  uint64_t fits = 0;
+  for (size_t i = 0; i < placements.size(); ++i) {
+    fits |= uint64_t{available.Contains(Footprint(placements[i].id))} << i;
+  }
+  return fits;
+}
+
+#ifdef BLOKUS_HAVE_AVX2_KERNEL
+// A bitboard is 7 words, which the kernel tests as two overlapping halves of 4
+// words, each in a single 256 bit register. Both halves are loaded from within
+// the bitboard, so there is no need for padding.
+static_assert(Bitboard::kNumWords == 7, "the AVX2 kernel needs 7 words");
+
+__attribute__((target("avx2"))) inline __m256i Load4(const uint64_t* words) {
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words));
+}
+
+__attribute__((target("avx2"))) uint64_t FittingPlacementsAvx2(
+    const Bitboard& available, absl::Span<const CornerPlacement> placements) {
+  const __m256i available_lo = Load4(available.words());
+  const __m256i available_hi = Load4(available.words() + 3);
+  const Bitboard* footprints = Tables().footprints.data();
+
+  uint64_t fits = 0;
+  size_t i = 0;
+  // Two placements per iteration keep more loads in flight.
+  for (; i + 1 < placements.size(); i += 2) {
+    const uint64_t* a = footprints[placements[i].id].words();
+    const uint64_t* b = footprints[placements[i + 1].id].words();
+    // testc(x, y) is 1 if y has no bits outside of x.
+    const int a_fits = _mm256_testc_si256(available_lo, Load4(a)) &
+        _mm256_testc_si256(available_hi, Load4(a + 3));
+    const int b_fits = _mm256_testc_si256(available_lo, Load4(b)) &
+        _mm256_testc_si256(available_hi, Load4(b + 3));
+    fits |= (uint64_t(a_fits) | uint64_t(b_fits) << 1) << i;
+  }
+  if (i < placements.size()) {
+    const uint64_t* a = footprints[placements[i].id].words();
+    fits |= uint64_t(_mm256_testc_si256(available_lo, Load4(a)) &
+                     _mm256_testc_si256(available_hi, Load4(a + 3))) << i;
+  }
+  return fits;
+}
+#endif
+
+using FittingPlacementsKernel = uint64_t (*)(
+    const Bitboard&, absl::Span<const CornerPlacement>);
+
+FittingPlacementsKernel ChooseFittingPlacementsKernel() {
+#ifdef BLOKUS_HAVE_AVX2_KERNEL
+  if (__builtin_cpu_supports("avx2")) return FittingPlacementsAvx2;
+#endif
+  return FittingPlacementsScalar;
+}
+
+}  // namespace
+
+int FirstOrientation(int tile) {
+  return Tables().first_orientation[tile];
+}
+
+const TileOrientation& GetOrientation(int orientation) {
+  return *Tables().orientations[orientation];
+}
+
+int OrientationIndex(int tile, int rotation, bool flip) {
+  if (tile < 0 || tile >= kNumTiles || rotation < 0 || rotation >= 4) {
+    return -1;
+  }
+  return Tables().orientation_index[tile][rotation][flip];
+}
+
+MoveId MakeMoveId(int orientation, int row, int col) {
+  const MoveIdTables& tables = Tables();
+  return tables.first_id[orientation] +
+      row * tables.num_anchor_cols[orientation] + col;
+}
+
+const MoveIdInfo& GetMoveIdInfo(MoveId id) {
+  DCHECK_LT(id, kNumMoveIds);
+  return Tables().infos[id];
+}
+
+const Bitboard& Footprint(MoveId id) {
+  DCHECK_LT(id, kNumMoveIds);
+  return Tables().footprints[id];
+}
+
+const Bitboard& Halo(MoveId id) {
+  DCHECK_LT(id, kNumMoveIds);
+  return Tables().halos[id];
+}
+
+absl::Span<const CornerPlacement> CornerPlacements(int tile, int row,
+                                                   int col) {
+  const MoveIdTables& tables = Tables();
+  const int i = tile * Bitboard::kNumBits + Bitboard::Index(row, col);
+  return absl::MakeConstSpan(
+      tables.corner_placements.data() + tables.first_corner_placement[i],
+      tables.corner_placements.data() + tables.first_corner_placement[i + 1]);
+}
+
+uint64_t FittingPlacements(const Bitboard& available,
+                           absl::Span<const CornerPlacement> placements) {
+  DCHECK_LE(placements.size(), 64);
+  static const FittingPlacementsKernel kernel =
+      ChooseFittingPlacementsKernel();
+  return kernel(available, placements);
+}
+
+}  // namespace blokus
@@ -0,0 +1,121 @@
+#ifndef BLOKUS_GAME_MOVE_ID_H_
+#define BLOKUS_GAME_MOVE_ID_H_
+
+#include <cstdint>
+
+#include "absl/log/check.h"
+#include "absl/types/span.h"
+
+#include "game/bitboard.h"
+#include "game/tile.h"
+
+namespace blokus {
+
+// A dense id for a move, without its color. Every placement of a tile that
+// fits on the empty board, i.e. an orientation plus the position of its
+// upper-left corner, has an id. The ids of an orientation are contiguous, with
+// the positions in row-major order, and orientations are in the order of the
+// list of all orientations of all tiles.
+using MoveId = uint16_t;
+
+// The number of placements that fit on the empty board.
+inline constexpr int kNumMoveIds = 30433;
+
+// The id of a pass, which is not a placement.
+inline constexpr MoveId kPassMoveId = kNumMoveIds;
+
+// Everything about the placement with a given id.
+struct MoveIdInfo {
+  uint8_t tile;
+  // The orientation's position in the list of all orientations of all tiles.
+  uint8_t orientation;
+  // The position of the upper-left corner of the orientation.
+  int8_t row;
+  int8_t col;
+};
+
+// Returns the index of the first orientation of `tile` in the list of all
+// orientations of all tiles.
+int FirstOrientation(int tile);
+
+// Returns the orientation with the given index in the list of all orientations
+// of all tiles.
+const TileOrientation& GetOrientation(int orientation);
+
+// Returns the index of the orientation of `tile` with the given rotation and
+// flip in the list of all orientations of all tiles, or -1 if the tile has no
+// such orientation.
+int OrientationIndex(int tile, int rotation, bool flip);
+
+// Returns the id of placing `orientation`, an index in the list of all
+// orientations, with its upper-left corner at (row, col). The orientation must
+// fit on the board there.
+MoveId MakeMoveId(int orientation, int row, int col);
+
+// Returns the placement with the given id, which must not be kPassMoveId.
+const MoveIdInfo& GetMoveIdInfo(MoveId id);
+
+// Returns the cells covered by the placement with the given id.
+const Bitboard& Footprint(MoveId id);
+
+// Returns the cells next to the edges of the placement with the given id,
+// which its color can't cover anymore once it is played.
+const Bitboard& Halo(MoveId id);
+
+// A placement that covers a cell with one of its corners.
+struct CornerPlacement {
+  MoveId id;
+  // The type of the corner that covers the cell.
+  Corner::Type type;
+};
+
+// Returns every placement of `tile` that covers (row, col) with one of its
+// corners, ordered by orientation and then by corner like
+// TileOrientation::corners(). A placement is legal for a color if the color
+// has a slot at a cell the placement covers with a corner, and the whole
+// Footprint is available to the color. Both are a few bitboard operations.
+absl::Span<const CornerPlacement> CornerPlacements(int tile, int row, int col);
+
+// Returns a mask with bit i set if placements[i] fits on `available`, i.e. if
+// `available` contains its whole Footprint. There can be at most 64
+// placements, which is more than any cell has in CornerPlacements. This is the
+// innermost loop of move generation, so it tests several placements at once
+// with AVX2 when the CPU supports it.
+uint64_t FittingPlacements(const Bitboard& available,
+                           absl::Span<const CornerPlacement> placements);
+
+// A list of moves with room for every placement, so that generating moves
+// never has to allocate. It is large, so prefer to reuse lists.
+class MoveList {
+ public:
+  MoveList() = default;
+
+  int size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  MoveId operator[](int i) const { return moves_[i]; }
+  const MoveId* begin() const { return moves_; }
+  const MoveId* end() const { return moves_ + size_; }
+
+  void clear() { size_ = 0; }
+  void push_back(MoveId id) { moves_[size_++] = id; }
+
+  // Returns the unused part of the list. After writing `n` moves to it, call
+  // Grow(n) to add them to the list.
+  absl::Span<MoveId> unused() {
+    return absl::MakeSpan(moves_ + size_, kNumMoveIds - size_);
+  }
+  void Grow(int n) {
+    DCHECK_LE(size_ + n, kNumMoveIds);
+    size_ += n;
+  }
+
+ private:
+  // A color can't have more legal moves than there are placements, so
+  // generating the moves of a single color always fits.
+  MoveId moves_[kNumMoveIds];
+  int size_ = 0;
+};
+
+}  // namespace blokus
+
+#endif
@@ -0,0 +1,167 @@
+#include "game/move_id.h"
+
+#include <random>
+#include <set>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include "game/bitboard.h"
+
+namespace blokus {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+
+TEST(MoveIdTest, EveryPlacementHasAUniqueId) {
+  std::set<MoveId> ids;
+  for (int orientation = 0; orientation < kNumOrientations; ++orientation) {
+    const TileOrientation& o = GetOrientation(orientation);
+    for (int row = 0; row + o.num_rows() <= Bitboard::kNumRows; ++row) {
+      for (int col = 0; col + o.num_cols() <= Bitboard::kNumCols; ++col) {
+        const MoveId id = MakeMoveId(orientation, row, col);
+        ASSERT_LT(id, kNumMoveIds);
+        EXPECT_TRUE(ids.insert(id).second) << id;
+
+        const MoveIdInfo& info = GetMoveIdInfo(id);
+        EXPECT_THAT(info.orientation, Eq(orientation));
+        EXPECT_THAT(info.row, Eq(row));
+        EXPECT_THAT(info.col, Eq(col));
+      }
+    }
+  }
+  EXPECT_THAT(ids.size(), Eq(kNumMoveIds));
+}
+
+TEST(MoveIdTest, OrientationsMatchTiles) {
+  EXPECT_THAT(FirstOrientation(0), Eq(0));
+  for (int tile = 0; tile < kNumTiles; ++tile) {
+    const int first = FirstOrientation(tile);
+    for (size_t i = 0; i < kTiles[tile].orientations().size(); ++i) {
+      EXPECT_THAT(&GetOrientation(first + i),
+                  Eq(&kTiles[tile].orientations()[i]));
+      EXPECT_THAT(GetMoveIdInfo(MakeMoveId(first + i, 0, 0)).tile, Eq(tile));
+    }
+  }
+}
+
+TEST(MoveIdTest, OrientationIndex) {
+  for (int tile = 0; tile < kNumTiles; ++tile) {
+    const int first = FirstOrientation(tile);
+    int num_found = 0;
+    for (int rotation = 0; rotation < 4; ++rotation) {
+      for (bool flip : {false, true}) {
+        const int index = OrientationIndex(tile, rotation, flip);
+        if (index < 0) continue;
+        ++num_found;
+        EXPECT_THAT(GetOrientation(index).rotation(), Eq(rotation));
+        EXPECT_THAT(GetOrientation(index).flip(), Eq(flip));
+        EXPECT_GE(index, first);
+        EXPECT_LT(index, first + kTiles[tile].orientations().size());
+      }
+    }
+    EXPECT_THAT(num_found, Eq(kTiles[tile].orientations().size()));
+  }
+  // The 1x1 tile looks the same in every orientation, so only has one.
+  EXPECT_THAT(OrientationIndex(0, 1, false), Eq(-1));
+  EXPECT_THAT(OrientationIndex(kNumTiles, 0, false), Eq(-1));
+  EXPECT_THAT(OrientationIndex(0, 4, false), Eq(-1));
+}
+
+TEST(MoveIdTest, FootprintAndHalo) {
+  // The 1x1 tile in the upper-left corner.
+  const MoveId id = MakeMoveId(FirstOrientation(0), 0, 0);
+  Bitboard footprint;
+  footprint.Set(0, 0);
+  EXPECT_THAT(Footprint(id), Eq(footprint));
+  Bitboard halo;
+  halo.Set(0, 1);
+  halo.Set(1, 0);
+  EXPECT_THAT(Halo(id), Eq(halo));
+
+  for (int i = 0; i < kNumMoveIds; ++i) {
+    const MoveIdInfo& info = GetMoveIdInfo(i);
+    ASSERT_FALSE(Footprint(i).Empty());
+    EXPECT_FALSE(Footprint(i).Intersects(Halo(i)));
+    EXPECT_TRUE(Footprint(i).Get(
+        info.row + GetOrientation(info.orientation).coords()[0].row(),
+        info.col + GetOrientation(info.orientation).coords()[0].col()));
+  }
+}
+
+TEST(MoveIdTest, CornerPlacementsCoverTheirCell) {
+  int num_placements = 0;
+  for (int tile = 0; tile < kNumTiles; ++tile) {
+    for (int row = 0; row < Bitboard::kNumRows; ++row) {
+      for (int col = 0; col < Bitboard::kNumCols; ++col) {
+        for (const CornerPlacement& placement :
+             CornerPlacements(tile, row, col)) {
+          EXPECT_THAT(GetMoveIdInfo(placement.id).tile, Eq(tile));
+          EXPECT_TRUE(Footprint(placement.id).Get(row, col));
+          ++num_placements;
+        }
+      }
+    }
+  }
+  // Every placement has at least one corner.
+  EXPECT_GE(num_placements, kNumMoveIds);
+
+  // The 1x1 tile only covers a cell by being placed on it.
+  ASSERT_THAT(CornerPlacements(0, 5, 7).size(), Eq(1));
+  EXPECT_THAT(GetMoveIdInfo(CornerPlacements(0, 5, 7)[0].id).row, Eq(5));
+  EXPECT_THAT(GetMoveIdInfo(CornerPlacements(0, 5, 7)[0].id).col, Eq(7));
+}
+
+TEST(MoveIdTest, FittingPlacements) {
+  std::mt19937 eng(0);
+  std::bernoulli_distribution dist(0.9);
+  for (int round = 0; round < 10; ++round) {
+    // A random board where most cells are available.
+    Bitboard available;
+    for (int row = 0; row < Bitboard::kNumRows; ++row) {
+      for (int col = 0; col < Bitboard::kNumCols; ++col) {
+        if (dist(eng)) available.Set(row, col);
+      }
+    }
+
+    for (int tile = 0; tile < kNumTiles; ++tile) {
+      for (int row = 0; row < Bitboard::kNumRows; ++row) {
+        for (int col = 0; col < Bitboard::kNumCols; ++col) {
+          const absl::Span<const CornerPlacement> placements =
+              CornerPlacements(tile, row, col);
+          const uint64_t fits = FittingPlacements(available, placements);
+          for (size_t i = 0; i < placements.size(); ++i) {
+            EXPECT_THAT((fits >> i) & 1,
+                        Eq(available.Contains(Footprint(placements[i].id))));
+          }
+          if (placements.size() < 64) {
+            EXPECT_THAT(fits >> placements.size(), Eq(0));
+          }
+        }
+      }
+    }
+  }
+
+  EXPECT_THAT(FittingPlacements(Bitboard::Full(), CornerPlacements(20, 0, 0)),
+              Eq((uint64_t{1} << CornerPlacements(20, 0, 0).size()) - 1));
+}
+
+TEST(MoveListTest, GrowAddsWrittenMoves) {
+  MoveList moves;
+  EXPECT_TRUE(moves.empty());
+  moves.push_back(7);
+  absl::Span<MoveId> unused = moves.unused();
+  ASSERT_THAT(unused.size(), Eq(kNumMoveIds - 1));
+  unused[0] = 3;
+  unused[1] = 5;
+  moves.Grow(2);
+  EXPECT_THAT(std::vector<MoveId>(moves.begin(), moves.end()),
+              ElementsAre(7, 3, 5));
+  moves.clear();
+  EXPECT_TRUE(moves.empty());
+}
+
+}  // namespace
+}  // namespace blokus
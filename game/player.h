@@ -13,8 +13,15 @@ class Player {
   // `player_id` must be a unique number from 0...num_players.
   explicit Player(int player_id) : player_id_(player_id) {}
   
+  virtual ~Player() = default;
+
   virtual Move SelectMove(const Game& board) = 0;
 
+  // Called after every move, by any player including this one, with the game
+  // after the move. Players can use this to think during the other players'
+  // turns, but must return quickly.
+  virtual void MoveMade(const Game& /*game*/, const Move& /*move*/) {}
+
   int player_id() const { return player_id_; }
   
  private:
@@ -0,0 +1,81 @@
+#ifndef BLOKUS_GAME_RNG_H_
+#define BLOKUS_GAME_RNG_H_
+
+#include <cstdint>
+
+namespace blokus {
+
+// A small and fast random number generator, xoshiro256** by Blackman and
+// Vigna. Results only depend on the seed, so runs with the same seeds are
+// reproducible on every platform.
+//
+// Rng is not thread safe, so give each thread its own, with the same seed and
+// a different stream. It is a standard uniform random bit generator, but
+// prefer Uniform for bounded numbers, since the standard distributions differ
+// between standard libraries.
+class Rng {
+ public:
+  using result_type = uint64_t;
+
+  // Generators with the same seed and different streams are independent.
+  explicit Rng(uint64_t seed, uint64_t stream = 0);
+
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return ~uint64_t{0}; }
+
+  result_type operator()();
+
+  // Returns a uniformly random number in [0, n). `n` must be positive.
+  uint32_t Uniform(uint32_t n);
+
+ private:
+  uint64_t s_[4];
+};
+
+inline Rng::Rng(uint64_t seed, uint64_t stream) {
+  // The state is filled from SplitMix64, as the xoshiro authors recommend.
+  // Each stream takes the next four outputs of the sequence for the seed, so
+  // no two streams start from the same state.
+  constexpr uint64_t kGamma = 0x9e3779b97f4a7c15;
+  uint64_t x = seed + 4 * stream * kGamma;
+  for (uint64_t& s : s_) {
+    uint64_t z = (x += kGamma);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    s = z ^ (z >> 31);
+  }
+}
+
+inline Rng::result_type Rng::operator()() {
+  const auto rotl = [](uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+  };
+  const uint64_t result = rotl(s_[1] * 5, 7) * 9;
+  const uint64_t t = s_[1] << 17;
+  s_[2] ^= s_[0];
+  s_[3] ^= s_[1];
+  s_[1] ^= s_[2];
+  s_[0] ^= s_[3];
+  s_[2] ^= t;
+  s_[3] = rotl(s_[3], 45);
+  return result;
+}
+
+inline uint32_t Rng::Uniform(uint32_t n) {
+  // Lemire's multiply and shift, which only needs a division in the rare case
+  // that the result could be biased.
+  uint64_t m = ((*this)() >> 32) * n;
+  uint32_t low = static_cast<uint32_t>(m);
+  if (low < n) {
+    const uint32_t threshold = -n % n;
+    while (low < threshold) {
+      m = ((*this)() >> 32) * n;
+      low = static_cast<uint32_t>(m);
+    }
+  }
+  return m >> 32;
+}
+
+}  // namespace blokus
+
+#endif
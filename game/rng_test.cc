@@ -0,0 +1,64 @@
+#include "game/rng.h"
+
+#include <set>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace blokus {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Lt;
+using ::testing::Ne;
+
+std::vector<uint64_t> Outputs(Rng rng, int n) {
+  std::vector<uint64_t> outputs;
+  for (int i = 0; i < n; ++i) {
+    outputs.push_back(rng());
+  }
+  return outputs;
+}
+
+TEST(RngTest, SameSeedAndStreamRepeat) {
+  EXPECT_THAT(Outputs(Rng(42), 100), Eq(Outputs(Rng(42), 100)));
+  EXPECT_THAT(Outputs(Rng(42, 3), 100), Eq(Outputs(Rng(42, 3), 100)));
+}
+
+TEST(RngTest, SeedsAndStreamsDiffer) {
+  std::set<uint64_t> firsts;
+  for (uint64_t seed = 0; seed < 10; ++seed) {
+    for (uint64_t stream = 0; stream < 10; ++stream) {
+      firsts.insert(Rng(seed, stream)());
+    }
+  }
+  EXPECT_THAT(firsts.size(), Eq(100));
+  EXPECT_THAT(Outputs(Rng(0, 0), 10), Ne(Outputs(Rng(0, 1), 10)));
+}
+
+TEST(RngTest, Uniform) {
+  Rng rng(7);
+  EXPECT_THAT(rng.Uniform(1), Eq(0));
+
+  // Every value comes up about as often as the others.
+  const int kNumValues = 10;
+  const int kNumSamples = 100000;
+  int counts[kNumValues] = {};
+  for (int i = 0; i < kNumSamples; ++i) {
+    const uint32_t value = rng.Uniform(kNumValues);
+    ASSERT_THAT(value, Lt(kNumValues));
+    ++counts[value];
+  }
+  for (int count : counts) {
+    EXPECT_NEAR(count, kNumSamples / kNumValues, kNumSamples / 100);
+  }
+
+  // Large bounds work too.
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_THAT(rng.Uniform(0xffffffff), Lt(0xffffffffu));
+  }
+}
+
+}  // namespace
+}  // namespace blokus
@@ -57,7 +57,7 @@ struct Corner {
   Type type;
 };
 
-inline bool CornerFitsSlot(const Corner& corner, const Slot& slot) {
+inline bool CornerFitsSlot(Corner::Type corner, Slot::Type slot) {
   static bool fit_map[10][9] = {
   // I  N  W  E  S  SE NE NW SW
     {0, 0, 0, 0, 0, 0, 0, 0, 0},  // INVALID
@@ -71,7 +71,11 @@ inline bool CornerFitsSlot(const Corner& corner, const Slot& slot) {
     {0, 0, 0, 0, 0, 0, 1, 0, 0},  // SW
     {0, 1, 1, 1, 1, 1, 1, 1, 1},  // ALL
   };
-  return fit_map[corner.type][slot.type];
+  return fit_map[corner][slot];
+}
+
+inline bool CornerFitsSlot(const Corner& corner, const Slot& slot) {
+  return CornerFitsSlot(corner.type, slot.type);
 }
 
 
@@ -198,6 +202,9 @@ class Tile {
 extern Tile kTiles[];
 
 inline constexpr int kNumTiles = 21;
+
+// The total number of orientations of all tiles.
+inline constexpr int kNumOrientations = 91;
   
 }  // namespace blokus
 
@@ -189,5 +189,13 @@ TEST(TileTest, Cross) {
   EXPECT_THAT(o.rows()[2], Eq(0b010));
 }
 
+TEST(TileTest, NumOrientations) {
+  int num_orientations = 0;
+  for (int tile = 0; tile < kNumTiles; ++tile) {
+    num_orientations += kTiles[tile].orientations().size();
+  }
+  EXPECT_THAT(num_orientations, Eq(kNumOrientations));
+}
+
 }  // namespace
 }  // namespace blokus
@@ -0,0 +1,63 @@
+#ifndef BLOKUS_GAME_ZOBRIST_H_
+#define BLOKUS_GAME_ZOBRIST_H_
+
+#include <cstdint>
+
+#include "game/bitboard.h"
+#include "game/tile.h"
+
+namespace blokus {
+
+// Random keys for Zobrist hashing of game positions. The hash of a position is
+// the xor of the keys of everything that is true about it, so making a move
+// only has to xor in the keys of what changed.
+//
+// The keys are generated at compile time from a fixed seed, so hashes are the
+// same from run to run and can be stored.
+struct ZobristKeys {
+  // A piece of the given color covers the cell, indexed by Bitboard::Index.
+  uint64_t cells[5][Bitboard::kNumBits];
+  // The color hasn't played the tile yet.
+  uint64_t tiles[5][kNumTiles];
+  // It is the color's turn to move.
+  uint64_t to_move[5];
+  // The color has passed, and is out of the game.
+  uint64_t passed[5];
+  // The color played the '1' tile as its last move, which affects its score.
+  uint64_t played_one_last[5];
+};
+
+namespace internal {
+
+// SplitMix64, see https://prng.di.unimi.it/splitmix64.c.
+constexpr uint64_t SplitMix64(uint64_t* state) {
+  uint64_t z = (*state += 0x9e3779b97f4a7c15);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return z ^ (z >> 31);
+}
+
+constexpr ZobristKeys MakeZobristKeys() {
+  ZobristKeys keys = {};
+  uint64_t state = 0x426c6f6b7573;
+  for (int color = 1; color < 5; ++color) {
+    for (int i = 0; i < Bitboard::kNumBits; ++i) {
+      keys.cells[color][i] = SplitMix64(&state);
+    }
+    for (int tile = 0; tile < kNumTiles; ++tile) {
+      keys.tiles[color][tile] = SplitMix64(&state);
+    }
+    keys.to_move[color] = SplitMix64(&state);
+    keys.passed[color] = SplitMix64(&state);
+    keys.played_one_last[color] = SplitMix64(&state);
+  }
+  return keys;
+}
+
+}  // namespace internal
+
+inline constexpr ZobristKeys kZobristKeys = internal::MakeZobristKeys();
+
+}  // namespace blokus
+
+#endif
@@ -11,6 +11,7 @@
 #include "absl/log/log.h"
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
 #include <jsoncpp/json/writer.h>
 
 #include "ai/mcts.h"
@@ -86,6 +87,7 @@ class MoveForwarder {
  public:
   void Handle(blokus::HttpServer::Request* request) {
     int next_player;
+    int player_to_move;
     Move next_move;
     while (true) {
       std::this_thread::sleep_for(std::chrono::milliseconds(10));
@@ -93,6 +95,8 @@ class MoveForwarder {
       if (!moves_.empty()) {
         next_player = players_.front();
         players_.pop_front();
+        player_to_move = players_to_move_.front();
+        players_to_move_.pop_front();
         next_move = moves_.front();
         moves_.pop_front();
         break;
@@ -100,6 +104,9 @@ class MoveForwarder {
     }
     Json::Value data;
     data["player"] = next_player;
+    // Colors that passed or can't move are skipped, so the client can't tell
+    // whose turn is next from the move alone. -1 once the game is over.
+    data["player_to_move"] = player_to_move;
     data["tile"] = next_move.tile;
     data["move"]["rotation"] = Json::Int(next_move.placement.rotation);
     data["move"]["flip"] = next_move.placement.flip;
@@ -112,12 +119,15 @@ class MoveForwarder {
 
   void NewMove(const Game& game, const Move& move) {
     std::lock_guard<std::mutex> lock(m_);
-    players_.emplace_back((game.current_player() + 3) % 4);
+    players_.emplace_back(game.PlayerOf(move.color));
+    players_to_move_.emplace_back(
+        game.Finished() ? -1 : game.current_player());
     moves_.emplace_back(move);
   }
   
  private:
   std::list<int> players_;
+  std::list<int> players_to_move_;
   std::list<Move> moves_;
   std::mutex m_;
 };
@@ -143,12 +153,21 @@ int main(int argc, char **argv) {
   blokus::GameRunner game(4);
   game.AddPlayer(absl::make_unique<blokus::WebPlayer>(0, &server));
 
+  // The players answer within a time limit, no matter how big the search
+  // is at this point of the game. The strong player also thinks while the
+  // others do, mostly while waiting for the human. Only one player ponders,
+  // so the others don't lose much of the machine during their turns.
   blokus::MctsOptions weak_options{
     .num_iterations = 20000,
+    .time_per_move = absl::Seconds(1),
     .num_threads = 8,
   };
   blokus::MctsOptions strong_options{
     .num_iterations = 200000,
+    .time_per_move = absl::Seconds(5),
+    .ponder = true,
+    // Pondering through a long human turn would grow the tree without end.
+    .max_tree_bytes = size_t{1} << 30,
     .num_threads = 8,
   };
   game.AddPlayer(absl::make_unique<blokus::MctsAI>(1, weak_options));
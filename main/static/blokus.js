@@ -262,16 +262,13 @@ class Blokus {
 	    .fail(function() {
 	      alert('ajax request /game/place failed!');
 	    });
-	  // Switch to the next player.
-	  // TODO(piotrf): make this a function in the 'model'.
-	  blokus.currentPlayer = (blokus.currentPlayer + 1) % 4;
+	  // The server says whose turn is next, since colors that passed or
+	  // can't move are skipped.
 	  blokus.lastHumanMove = blokus.pendingMove;
 	  blokus.pendingMove = null;
 	  blokus.holdingPiece = null;
-	  if (PLAYERS[blokus.currentPlayer].type == 'computer') {
-	    blokus.waiting = true;
-	    blokus.getNextServerMove();
-	  }
+	  blokus.waiting = true;
+	  blokus.getNextServerMove();
 	}
 
       }
@@ -313,16 +310,13 @@ class Blokus {
 	  .fail(function() {
 	    alert('ajax request /game/place failed!');
 	  });
-	// Switch to the next player.
-	// TODO(piotrf): make this a function in the 'model'.
-	blokus.currentPlayer = (blokus.currentPlayer + 1) % 4;
+	// The server says whose turn is next, since colors that passed or
+	// can't move are skipped.
 	blokus.lastHumanMove = blokus.pendingMove;
 	blokus.pendingMove = null;
 	blokus.holdingPiece = null;
-	if (PLAYERS[blokus.currentPlayer].type == 'computer') {
-	  blokus.waiting = true;
-	  blokus.getNextServerMove();
-	}
+	blokus.waiting = true;
+	blokus.getNextServerMove();
       }
       blokus.draw();
     }
@@ -331,24 +325,27 @@ class Blokus {
   getNextServerMove() {
     var blokus = this;
     $.getJSON('/game/next_move', function(data) {
-      // TODO(piotrf): hacky.
-      if (data.player == 0) {
-	blokus.getNextServerMove();
-      } else {
+      // Our own moves come back too, but are already on the board.
+      if (PLAYERS[data.player].type == 'computer') {
 	console.log('next machine move!');
 	console.log(data);
 	if (data.tile != -1) {
  	  blokus.board.place(tiles.TILES[data.tile],
-	  		     PLAYERS[blokus.currentPlayer].color, data.move);
-	  blokus.ui.useTile(data.tile, PLAYERS[blokus.currentPlayer].color);
+	  		     PLAYERS[data.player].color, data.move);
+	  blokus.ui.useTile(data.tile, PLAYERS[data.player].color);
 	}
-	blokus.currentPlayer = (blokus.currentPlayer + 1) % 4;
+      }
+      // Keep waiting once the game is over.
+      if (data.player_to_move == -1) {
         blokus.draw();
-	if (PLAYERS[blokus.currentPlayer].type == 'computer') {
-	  blokus.getNextServerMove();
-	} else {
-	  blokus.waiting = false;
-	}
+	return;
+      }
+      blokus.currentPlayer = data.player_to_move;
+      blokus.draw();
+      if (PLAYERS[blokus.currentPlayer].type == 'computer') {
+	blokus.getNextServerMove();
+      } else {
+	blokus.waiting = false;
       }
     }).fail(function(data) {
       alert('ajax request to /game/next_move failed!');
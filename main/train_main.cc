@@ -10,17 +10,32 @@
 #include "ai/mcts.h"
 #include "ai/random.h"
 #include "game/game_runner.h"
+#include "game/rng.h"
 
-ABSL_FLAG(int, seed, -1, "Random number seed. If -1, use time.");
+ABSL_FLAG(int, seed, -1,
+          "Random number seed. If -1, use time. Runs only repeat with one "
+          "MCTS thread, no time budgets and no pondering.");
 ABSL_FLAG(int, num_games, 10, "Number of games to play.");
 ABSL_FLAG(bool, print_board, false, "Print the board during play.");
 
 ABSL_FLAG(int, num_players, 2, "Number of players, 2 or 4.");
 ABSL_FLAG(int, num_mcts_iterations, 10000,
           "Number of MCTS iterations to run per move.");
+ABSL_FLAG(absl::Duration, mcts_time_per_move, absl::ZeroDuration(),
+          "If positive, the most time MCTS may spend on a move.");
+ABSL_FLAG(absl::Duration, mcts_time_per_game, absl::ZeroDuration(),
+          "If positive, the time MCTS may spend on all moves in a game.");
+ABSL_FLAG(bool, mcts_ponder, false,
+          "Keep searching during the other players' turns.");
+ABSL_FLAG(int64_t, mcts_max_tree_mb, 0,
+          "If positive, the size at which MCTS trees stop growing, in MB.");
 ABSL_FLAG(int, num_mcts_rollouts, 1,
           "Number of MCTS rollouts per iterations.");
 ABSL_FLAG(int, num_mcts_threads, 1, "Number of MCTS threads.");
+ABSL_FLAG(bool, mcts_unmake_moves, true,
+          "Take back moves during MCTS instead of copying the game.");
+ABSL_FLAG(bool, mcts_transpositions, false,
+          "Share MCTS statistics between transposed positions.");
 
 int main(int argc, char **argv) {
   // Initialize command line flags and logging.
@@ -31,11 +46,10 @@ int main(int argc, char **argv) {
   CHECK(num_players == 2 || num_players == 4);
   const int num_games = absl::GetFlag(FLAGS_num_games);
 
-  if (absl::GetFlag(FLAGS_seed) != -1) {
-    srand(absl::GetFlag(FLAGS_seed));
-  } else {
-    srand(time(NULL));
-  }
+  // Every game gets its own seed, drawn from the one for the whole run.
+  blokus::Rng seeds(absl::GetFlag(FLAGS_seed) != -1
+                        ? absl::GetFlag(FLAGS_seed)
+                        : absl::ToUnixNanos(absl::Now()));
 
   std::vector<int> total_scores(num_players, 0);
 
@@ -45,8 +59,16 @@ int main(int argc, char **argv) {
     blokus::MctsOptions options{
       .c = 1.4,
       .num_iterations = absl::GetFlag(FLAGS_num_mcts_iterations),
+      .time_per_move = absl::GetFlag(FLAGS_mcts_time_per_move),
+      .time_per_game = absl::GetFlag(FLAGS_mcts_time_per_game),
+      .ponder = absl::GetFlag(FLAGS_mcts_ponder),
+      .max_tree_bytes =
+          static_cast<size_t>(absl::GetFlag(FLAGS_mcts_max_tree_mb)) << 20,
       .num_rollouts_per_iteration = absl::GetFlag(FLAGS_num_mcts_rollouts),
       .num_threads = absl::GetFlag(FLAGS_num_mcts_threads),
+      .unmake_moves = absl::GetFlag(FLAGS_mcts_unmake_moves),
+      .use_transpositions = absl::GetFlag(FLAGS_mcts_transpositions),
+      .seed = seeds(),
     };
     game.AddPlayer(absl::make_unique<blokus::MctsAI>(0, options));
     game.AddPlayer(absl::make_unique<blokus::MctsAI>(1, options));